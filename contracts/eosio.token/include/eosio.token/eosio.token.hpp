@@ -4,6 +4,8 @@
 #include <eosio/eosio.hpp>
 
 #include <string>
+#include <utility>
+#include <vector>
 
 namespace eosiosystem {
    class system_contract;
@@ -69,6 +71,21 @@ namespace eosio {
                         const name&    to,
                         const asset&   quantity,
                         const string&  memo );
+
+         /**
+          * Allows `from` account to transfer tokens of a single symbol to many recipients in one action.
+          * `from` is debited once for the sum and each recipient is credited with its quantity.
+          *
+          * @param from - the account to transfer from,
+          * @param transfers - the recipients paired with the quantity each one receives,
+          * @param memo - the memo string to accompany the transaction.
+          *
+          * @pre All quantities have to be positive and share the same symbol.
+          */
+         [[eosio::action]]
+         void transfermany( const name&                                from,
+                            const std::vector<std::pair<name, asset>>& transfers,
+                            const string&                              memo );
          /**
           * Allows `ram_payer` to create an account `owner` with zero balance for
           * token `symbol` at the expense of `ram_payer`.
@@ -114,6 +131,7 @@ namespace eosio {
          using issue_action = eosio::action_wrapper<"issue"_n, &token::issue>;
          using retire_action = eosio::action_wrapper<"retire"_n, &token::retire>;
          using transfer_action = eosio::action_wrapper<"transfer"_n, &token::transfer>;
+         using transfermany_action = eosio::action_wrapper<"transfermany"_n, &token::transfermany>;
          using open_action = eosio::action_wrapper<"open"_n, &token::open>;
          using close_action = eosio::action_wrapper<"close"_n, &token::close>;
       private:
@@ -101,6 +101,43 @@ namespace eosio
     add_balance(to, quantity, payer);
   }
 
+  void token::transfermany(const name &from,
+                           const std::vector<std::pair<name, asset>> &transfers,
+                           const string &memo)
+  {
+    check(!transfers.empty(), "no transfers");
+    require_auth(from);
+    auto sym = transfers.front().second.symbol;
+    stats statstable(get_self(), sym.code().raw());
+    const auto &st = statstable.get(sym.code().raw());
+
+    check(sym == st.supply.symbol, "symbol precision mismatch");
+    check(memo.size() <= 256, "memo has more than 256 bytes");
+
+    require_recipient(from);
+
+    auto total = asset(0, sym);
+    for (const auto &t : transfers)
+    {
+      const auto &to = t.first;
+      const auto &quantity = t.second;
+      check(from != to, "cannot transfer to self");
+      check(is_account(to), "to account does not exist");
+      check(quantity.is_valid(), "invalid quantity");
+      check(quantity.amount > 0, "must transfer positive quantity");
+      check(quantity.symbol == sym, "symbol precision mismatch");
+      total += quantity;
+      require_recipient(to);
+    }
+
+    sub_balance(from, total);
+    for (const auto &t : transfers)
+    {
+      auto payer = has_auth(t.first) ? t.first : from;
+      add_balance(t.first, t.second, payer);
+    }
+  }
+
   void token::sub_balance(const name &owner, const asset &value)
   {
     accounts from_acnts(get_self(), owner.value);
@@ -0,0 +1,190 @@
+#pragma once
+#include <safemath.hpp>
+#include <algorithm>
+#include <array>
+
+// Pool reward math on plain integers. Nothing here touches eosio types or
+// tables, so the same header builds into the contract and, with XPOOL_NATIVE
+// defined, into native tools such as tools/xpool-sim.
+namespace core
+{
+  static constexpr uint64_t REWARD_PRECISION = 1'0000'0000'0000;
+  static constexpr uint64_t DEV_FEE_RATIO = 10;
+
+  typedef std::array<uint8_t, 32> digest;
+
+  struct deposit_split
+  {
+    uint64_t to_stake;
+    uint64_t to_dev;
+  };
+
+  // reward released evenly between start_time and end_time
+  struct segment
+  {
+    uint32_t start_time;
+    uint32_t end_time;
+    uint64_t amount;
+  };
+
+  struct accumulator
+  {
+    uint128_t acc_reward_per_share; // reward per staked unit, scaled by REWARD_PRECISION
+    uint64_t reward_dust;           // remainder of the last division, carried forward
+  };
+
+  // the part of a pool that accrual moves forward
+  struct pool_counters
+  {
+    uint64_t total_staked;
+    uint64_t released_reward;
+    uint32_t last_harvest_time;
+    accumulator acc;
+  };
+
+  inline deposit_split split_deposit(const uint64_t quantity)
+  {
+    auto to_dev = safemath::div(quantity, DEV_FEE_RATIO); // 10% To Dev
+    return {safemath::sub(quantity, to_dev), to_dev};     // 90% To Pool
+  }
+
+  // a fee-only deposit sends just the 10%, the 90% it stands for stays with the depositor
+  inline deposit_split split_fee(const uint64_t fee)
+  {
+    return {safemath::mul(fee, DEV_FEE_RATIO - 1), fee};
+  }
+
+  // reward a segment has released by `time`, exactly `amount` once it has ended
+  inline uint64_t emitted(const segment &s, const uint32_t time)
+  {
+    if (time <= s.start_time)
+      return 0;
+    if (time >= s.end_time)
+      return s.amount;
+    return uint64_t(safemath::mul_div(s.amount, time - s.start_time, s.end_time - s.start_time));
+  }
+
+  template <typename Schedule>
+  inline uint64_t emitted(const Schedule &schedule, const uint32_t time)
+  {
+    uint64_t total = 0;
+    for (const auto &s : schedule)
+    {
+      if (time <= s.start_time)
+        break;
+      total = safemath::add(total, emitted(s, time));
+    }
+    return total;
+  }
+
+  // Reward to release now that `emitted_reward` is due in total. Working from
+  // the cumulative total, rather than a rate times the elapsed time, carries
+  // the rounding of every accrual forward so the schedule's full amount is
+  // released by its end.
+  inline uint64_t released_reward(const uint64_t emitted_reward, const uint64_t released_so_far)
+  {
+    return emitted_reward > released_so_far ? emitted_reward - released_so_far : 0;
+  }
+
+  // segments follow each other without gaps from start_time to end_time and add up to total_reward
+  template <typename Schedule>
+  inline bool valid_schedule(const Schedule &schedule, const uint32_t start_time, const uint32_t end_time, const uint64_t total_reward)
+  {
+    auto time = start_time;
+    uint64_t total = 0;
+    for (const auto &s : schedule)
+    {
+      if (s.start_time != time || s.end_time <= s.start_time || s.amount == 0)
+        return false;
+      time = s.end_time;
+      total = safemath::add(total, s.amount);
+    }
+    return time == end_time && total == total_reward;
+  }
+
+  inline void accrue(accumulator &acc, const uint64_t token_issued, const uint64_t total_staked)
+  {
+    uint128_t dust;
+    auto acc_delta = safemath::mul_div(token_issued, REWARD_PRECISION, total_staked, dust);
+    dust += acc.reward_dust;
+    acc.acc_reward_per_share += acc_delta + dust / total_staked;
+    acc.reward_dust = uint64_t(dust % total_staked);
+  }
+
+  // Settles the reward released since last_harvest_time into the accumulator,
+  // up to now_time but never past end_time; `emitted(time)` is the pool's
+  // cumulative emission. While nothing is staked the time stays unsettled, so
+  // the next staker receives it and the pool still releases its whole reward.
+  template <typename Emitted>
+  inline bool accrue_pool(pool_counters &c, const uint32_t end_time, const uint32_t now_time, Emitted emitted)
+  {
+    const auto to_time = std::min(now_time, end_time);
+    if (to_time <= c.last_harvest_time || c.total_staked == 0)
+      return false;
+
+    const auto issued = released_reward(emitted(to_time), c.released_reward);
+    accrue(c.acc, issued, c.total_staked);
+    c.released_reward = safemath::add(c.released_reward, issued);
+    c.last_harvest_time = to_time;
+    return true;
+  }
+
+  // staked * acc_reward_per_share, still scaled by REWARD_PRECISION
+  inline uint128_t scaled_reward(const uint128_t acc_reward_per_share, const uint64_t staked)
+  {
+    return safemath::mul_div(staked, acc_reward_per_share, 1);
+  }
+
+  // whole reward units owed since the last settlement
+  inline uint64_t pending_reward(const uint128_t acc_reward_per_share, const uint64_t staked, const uint128_t reward_debt, const uint64_t max_amount)
+  {
+    auto scaled = scaled_reward(acc_reward_per_share, staked);
+    safemath::check(scaled >= reward_debt, "sub-overflow");
+    auto amount = (scaled - reward_debt) / REWARD_PRECISION;
+    safemath::check(amount <= max_amount, "invalid amount");
+    return uint64_t(amount);
+  }
+
+  // debt once pending_reward has been settled and the stake moved to new_staked;
+  // the fraction of a unit pending_reward could not pay is carried to the next settlement
+  inline uint128_t reward_debt(const uint128_t acc_reward_per_share, const uint64_t staked, const uint128_t reward_debt, const uint64_t new_staked)
+  {
+    auto carry = (scaled_reward(acc_reward_per_share, staked) - reward_debt) % REWARD_PRECISION;
+    return scaled_reward(acc_reward_per_share, new_staked) - carry;
+  }
+
+  // Merkle distributions. A leaf is the hash of owner, pool_id, epoch and
+  // amount as little-endian 64-bit words; a parent is the hash of its two
+  // children in ascending byte order, so a proof is just the sibling hashes
+  // from leaf to root. A node left without a sibling moves up unchanged.
+  inline std::array<uint8_t, 32> leaf_message(const uint64_t owner, const uint64_t pool_id, const uint64_t epoch, const uint64_t amount)
+  {
+    const uint64_t words[4] = {owner, pool_id, epoch, amount};
+    std::array<uint8_t, 32> msg;
+    for (int w = 0; w < 4; w++)
+    {
+      for (int b = 0; b < 8; b++)
+        msg[w * 8 + b] = uint8_t(words[w] >> (8 * b));
+    }
+    return msg;
+  }
+
+  // `hash` is sha256 over (const uint8_t *, size_t), returning a digest
+  template <typename Hash>
+  inline digest hash_pair(const digest &a, const digest &b, Hash hash)
+  {
+    std::array<uint8_t, 64> msg;
+    const auto &lo = a < b ? a : b;
+    const auto &hi = a < b ? b : a;
+    std::copy(lo.begin(), lo.end(), msg.begin());
+    std::copy(hi.begin(), hi.end(), msg.begin() + 32);
+    return hash(msg.data(), msg.size());
+  }
+
+  // share of a distribution's total for one weight, such as stake times the
+  // seconds it was held, rounded down
+  inline uint64_t distribution_share(const uint64_t total, const uint128_t weight, const uint128_t total_weight)
+  {
+    return uint64_t(safemath::mul_div(total, weight, total_weight));
+  }
+} // namespace core
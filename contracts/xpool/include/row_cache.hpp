@@ -0,0 +1,119 @@
+#pragma once
+#include <eosio/eosio.hpp>
+#include <deque>
+
+// Rows of one multi_index scope, held for the length of an action. Each row
+// is read from the table once; emplace and modify only change the in-memory
+// copy, and flush (or the destructor) writes every new row with one emplace
+// and every changed row with one modify, whatever it went through before.
+//
+// The table itself is not exposed: while a cache is alive, rows of its scope
+// are read and written through it only, so no reader sees a row the cache
+// has not written back yet.
+template <typename Table, typename Row>
+class row_cache
+{
+public:
+  row_cache(eosio::name code, uint64_t scope) : _tbl(code, scope) {}
+  ~row_cache() { flush(); }
+
+  row_cache(const row_cache &) = delete;
+  row_cache &operator=(const row_cache &) = delete;
+
+  uint64_t get_scope() const { return _tbl.get_scope(); }
+
+  const Row *find(uint64_t pk)
+  {
+    auto e = lookup(pk);
+    return e == nullptr ? nullptr : &e->row;
+  }
+
+  const Row &get(uint64_t pk, const char *error_msg)
+  {
+    auto row = find(pk);
+    eosio::check(row != nullptr, error_msg);
+    return *row;
+  }
+
+  // the row is stored by the next flush, with the payer given here
+  template <typename Lambda>
+  const Row &emplace(eosio::name payer, Lambda &&constructor)
+  {
+    Row row{};
+    constructor(row);
+    eosio::check(lookup(row.primary_key()) == nullptr, "Row exists");
+    _entries.push_back({row, state::created, payer});
+    return _entries.back().row;
+  }
+
+  template <typename Lambda>
+  void modify(const Row &row, Lambda &&updater)
+  {
+    const auto pk = row.primary_key();
+    auto e = lookup(pk);
+    eosio::check(e != nullptr, "Row not cached");
+    updater(e->row);
+    eosio::check(e->row.primary_key() == pk, "Cannot change primary key");
+    if (e->st == state::clean)
+    {
+      e->st = state::dirty;
+    }
+  }
+
+  void flush()
+  {
+    for (auto &e : _entries)
+    {
+      if (e.st == state::created)
+      {
+        _tbl.emplace(e.payer, [&](auto &a) {
+          a = e.row;
+        });
+      }
+      else if (e.st == state::dirty)
+      {
+        _tbl.modify(_tbl.get(e.row.primary_key()), eosio::same_payer, [&](auto &a) {
+          a = e.row;
+        });
+      }
+      e.st = state::clean;
+    }
+  }
+
+private:
+  enum class state : uint8_t
+  {
+    clean,
+    dirty,
+    created
+  };
+
+  struct entry
+  {
+    Row row;
+    state st;
+    eosio::name payer;
+  };
+
+  entry *lookup(uint64_t pk)
+  {
+    for (auto &e : _entries)
+    {
+      if (e.row.primary_key() == pk)
+      {
+        return &e;
+      }
+    }
+    auto itr = _tbl.find(pk);
+    if (itr == _tbl.end())
+    {
+      return nullptr;
+    }
+    // deque keeps earlier rows in place, so references handed out stay valid
+    _entries.push_back({*itr, state::clean, eosio::name()});
+    return &_entries.back();
+  }
+
+  Table _tbl;
+  std::deque<entry> _entries;
+};
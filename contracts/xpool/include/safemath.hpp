@@ -1,22 +1,52 @@
+#pragma once
+
+#ifdef XPOOL_NATIVE
+#include <cstdint>
+#include <stdexcept>
+
+typedef unsigned __int128 uint128_t;
+#else
+#include <eosio/eosio.hpp>
+#endif
+
 namespace safemath {
-    using std::string;
-    uint64_t add(const uint64_t a, const uint64_t b) {
+#ifdef XPOOL_NATIVE
+    inline void check(bool pred, const char *msg) {
+        if (!pred) throw std::runtime_error(msg);
+    }
+#else
+    using eosio::check;
+#endif
+
+    inline uint64_t add(const uint64_t a, const uint64_t b) {
         uint64_t c = a + b;
         check(c >= a, "add-overflow"); return c;
     }
 
-    uint64_t sub(const uint64_t a, const uint64_t b) {
+    inline uint64_t sub(const uint64_t a, const uint64_t b) {
         uint64_t c = a - b;
         check(c <= a, "sub-overflow"); return c;
     }
 
-    uint64_t mul(const uint64_t a, const uint64_t b) {
+    inline uint64_t mul(const uint64_t a, const uint64_t b) {
         uint64_t c = a * b;
         check(b == 0 || c / b == a, "mul-overflow"); return c;
     }
 
-    uint64_t div(const uint64_t a, const uint64_t b) {
+    inline uint64_t div(const uint64_t a, const uint64_t b) {
         check(b > 0, "divide by zero");
         return a / b;
     }
-} // namespace safemath
\ No newline at end of file
+
+    inline uint128_t mul_div(const uint128_t a, const uint128_t b, const uint128_t c, uint128_t &remainder) {
+        check(c > 0, "divide by zero");
+        uint128_t p = a * b;
+        check(b == 0 || p / b == a, "mul-overflow");
+        remainder = p % c; return p / c;
+    }
+
+    inline uint128_t mul_div(const uint128_t a, const uint128_t b, const uint128_t c) {
+        uint128_t remainder;
+        return mul_div(a, b, c, remainder);
+    }
+} // namespace safemath
@@ -1,5 +1,9 @@
 #include <utils.hpp>
-#include <safemath.hpp>
+#include <core.hpp>
+#include <row_cache.hpp>
+#include <eosio/singleton.hpp>
+#include <eosio/binary_extension.hpp>
+#include <eosio/crypto.hpp>
 
 CONTRACT xpool : public contract
 {
@@ -12,16 +16,93 @@ public:
   static constexpr name FUND = name("eoscatsdever");
   static constexpr symbol MINED_SYMBOL = symbol("CAT", 4);
   static constexpr symbol_code MINED_SYMBOL_CODE = symbol_code("CAT");
+  static constexpr name RAM_TOKEN = name("eosio.token");
+  static constexpr symbol RAM_SYMBOL = symbol("EOS", 4);
+  static constexpr uint32_t RAM_BATCH_WINDOW = 10 * 60;
   static constexpr int64_t MAX_SUPPLY = 2'1000'0000;
+  static constexpr const char *FEE_ONLY_MEMO = "fee";
 
-  ACTION create(name contract, symbol sym, asset reward, uint32_t epoch_time, uint32_t duration, asset min_staked, uint8_t type);
+  // a missing or empty schedule releases reward evenly over [epoch_time, epoch_time + duration]
+  ACTION create(name contract, symbol sym, asset reward, uint32_t epoch_time, uint32_t duration, asset min_staked, uint8_t type,
+                binary_extension<vector<core::segment>> schedule);
   ACTION claim(name owner, uint64_t pool_id);
+  ACTION claimall(name owner);
   ACTION harvest(uint64_t pool_id, uint32_t nonce);
+  ACTION harvestall(uint32_t nonce);
+  ACTION migrate();
+  ACTION sweepfees(name contract, symbol sym);
+  ACTION flushram(uint32_t limit);
+
+  // alternative to accrual: rewards computed off-chain per pool and epoch,
+  // committed as a merkle root and claimed with a proof (see core::leaf_message)
+  ACTION setroot(uint64_t pool_id, uint64_t epoch, checksum256 root, asset total);
+  ACTION claimproof(name owner, uint64_t pool_id, uint64_t epoch, asset amount, vector<checksum256> proof);
+
+  struct pool_pending
+  {
+    uint64_t pool_id;
+    asset quantity; // what claim would pay right now
+  };
+
+  // read-only: answers with a logpending inline action, nothing is written
+  ACTION getpending(name owner, vector<uint64_t> pool_ids);
+
+  // sent inline to self with the deltas of each state change, for off-chain indexers
+  ACTION logdeposit(name owner, uint64_t pool_id, asset staked, asset fee, asset settled);
+  ACTION logharvest(uint64_t pool_id, asset released, uint128_t acc_reward_per_share, uint32_t harvest_time);
+  ACTION logclaim(name owner, uint64_t pool_id, asset quantity);
+  ACTION logpending(name owner, vector<pool_pending> pending);
+
+  using logdeposit_action = action_wrapper<"logdeposit"_n, &xpool::logdeposit>;
+  using logharvest_action = action_wrapper<"logharvest"_n, &xpool::logharvest>;
+  using logclaim_action = action_wrapper<"logclaim"_n, &xpool::logclaim>;
+  using logpending_action = action_wrapper<"logpending"_n, &xpool::logpending>;
 
   void handle_transfer(name from, name to, asset quantity, string memo, name code);
 
+  struct miner_info
+  {
+    name owner;
+    asset staked;
+    asset claimed;
+    asset unclaimed;
+    asset pending; // reward accrued up to now, not yet settled into unclaimed
+  };
+
+  // read-only view of a miner row in either layout, with symbols filled in from the pool
+  static miner_info get_miner(const name &pool_contract, const uint64_t pool_id, const name &owner);
+  static vector<pool_pending> get_pending(const name &pool_contract, const name &owner, const vector<uint64_t> &pool_ids);
+  // ids of the pools owner has a miner row in
+  static vector<uint64_t> get_positions(const name &pool_contract, const name &owner);
+  // whether some pool stakes sym from contract, checked before a transfer is unpacked
+  static bool is_pool_token(const name &pool_contract, const name &contract, const symbol &sym);
+
 private:
+  // pool config, written once by create; the counters in it are only the
+  // starting values of the pool's poolstats row
   TABLE pool
+  {
+    uint64_t id;
+    uint8_t type;
+    name contract;
+    symbol sym;
+    asset total_staked;
+    asset total_reward;
+    asset released_reward;
+    uint32_t epoch_time;
+    uint32_t duration;
+    asset min_staked;
+    uint32_t last_harvest_time;
+    // missing from rows written before the accumulator existed, read as 0
+    binary_extension<uint128_t> acc_reward_per_share;
+    binary_extension<uint64_t> reward_dust;
+    binary_extension<vector<core::segment>> schedule; // empty or missing: flat over the mining period
+    uint64_t primary_key() const { return id; }
+    uint128_t by_token() const { return token_key(contract, sym, type); }
+  };
+
+  // pools row as deployed before the accumulator, read only by migrate
+  struct pool_v0
   {
     uint64_t id;
     uint8_t type;
@@ -37,7 +118,33 @@ private:
     uint64_t primary_key() const { return id; }
   };
 
+  // live counters of the pool with the same id, the only pool row a deposit
+  // or accrual writes: total_staked is in the pool's sym, released_reward in MINED_SYMBOL
+  TABLE poolstat
+  {
+    uint64_t id;
+    int64_t total_staked;
+    int64_t released_reward;
+    uint32_t last_harvest_time;
+    uint128_t acc_reward_per_share; // CAT per staked unit, scaled by core::REWARD_PRECISION
+    uint64_t reward_dust;           // remainder of the last accumulator division, carried forward
+    int64_t distributed;            // CAT committed by setroot; once set the pool no longer accrues
+    uint64_t primary_key() const { return id; }
+  };
+
+  // compact layout: staked is in the pool's sym, claimed and unclaimed in MINED_SYMBOL
   TABLE miner
+  {
+    name owner;
+    int64_t staked;
+    int64_t claimed;
+    int64_t unclaimed;
+    uint128_t reward_debt; // staked * acc_reward_per_share at the last settlement, less the unpaid fraction
+    uint64_t primary_key() const { return owner.value; }
+  };
+
+  // miners table as deployed, rewritten to the compact layout on first touch
+  TABLE miner_v0
   {
     name owner;
     asset staked;
@@ -46,6 +153,122 @@ private:
     uint64_t primary_key() const { return owner.value; }
   };
 
-  typedef eosio::multi_index<"pools"_n, pool> pools_mi;
-  typedef eosio::multi_index<"miners"_n, miner> miners_mi;
+  // dev fees collected from deposits, scoped by token contract
+  TABLE fee
+  {
+    asset balance;
+    uint64_t primary_key() const { return balance.symbol.code().raw(); }
+  };
+
+  // RAM pool deposits waiting for the next flushram, one row per depositor
+  TABLE ramorder
+  {
+    name owner;
+    asset quantity;
+    uint64_t primary_key() const { return owner.value; }
+  };
+
+  // pools an owner has a miner row in, so per-owner work skips the other pools
+  TABLE position
+  {
+    name owner;
+    vector<uint64_t> pool_ids;
+    uint64_t primary_key() const { return owner.value; }
+  };
+
+  // merkle root of one epoch's off-chain rewards, scoped by pool id
+  TABLE distribution
+  {
+    uint64_t epoch;
+    checksum256 root;
+    asset total;
+    asset claimed;
+    uint64_t primary_key() const { return epoch; }
+  };
+
+  // one row per epoch an owner has claimed with a proof, scoped by pool id
+  TABLE proofclaim
+  {
+    uint64_t id;
+    name owner;
+    uint64_t epoch;
+    uint64_t primary_key() const { return id; }
+    uint128_t by_claim() const { return claim_key(owner, epoch); }
+  };
+
+  // symbols staked by some pool, one row per token contract
+  TABLE token
+  {
+    name contract;
+    vector<symbol> syms;
+    uint64_t primary_key() const { return contract.value; }
+  };
+
+  // balance row of an eosio.token style contract, read for fee-only deposits
+  struct token_account
+  {
+    asset balance;
+    uint64_t primary_key() const { return balance.symbol.code().raw(); }
+  };
+
+  TABLE global
+  {
+    asset allocated_reward;
+    uint64_t pool_count;
+    uint32_t last_ram_flush;
+  };
+
+  typedef eosio::singleton<"global"_n, global> global_singleton;
+  typedef eosio::multi_index<"pools"_n, pool,
+                             indexed_by<"bytoken"_n, const_mem_fun<pool, uint128_t, &pool::by_token>>>
+      pools_mi;
+  // pools table as deployed, without the bytoken index, used by migrate
+  typedef eosio::multi_index<"pools"_n, pool_v0> pools_legacy_mi;
+  typedef eosio::multi_index<"poolstats"_n, poolstat> poolstats_mi;
+  typedef eosio::multi_index<"minersv1"_n, miner> miners_mi;
+  typedef eosio::multi_index<"miners"_n, miner_v0> miners_v0_mi;
+  typedef eosio::multi_index<"fees"_n, fee> fees_mi;
+  typedef eosio::multi_index<"ramorders"_n, ramorder> ramorders_mi;
+  typedef eosio::multi_index<"tokens"_n, token> tokens_mi;
+  typedef eosio::multi_index<"positions"_n, position> positions_mi;
+  typedef eosio::multi_index<"distribs"_n, distribution> distributions_mi;
+  typedef eosio::multi_index<"proofclaims"_n, proofclaim,
+                             indexed_by<"byclaim"_n, const_mem_fun<proofclaim, uint128_t, &proofclaim::by_claim>>>
+      proofclaims_mi;
+  typedef eosio::multi_index<"accounts"_n, token_account> token_accounts_mi;
+  typedef row_cache<poolstats_mi, poolstat> poolstats_cache;
+  typedef row_cache<miners_mi, miner> miners_cache;
+
+  // contract (64 bits) | symbol code (56 bits) | pool type (8 bits)
+  static uint128_t token_key(const name &contract, const symbol &sym, const uint8_t type)
+  {
+    return (uint128_t(contract.value) << 64) | (uint128_t(sym.code().raw()) << 8) | type;
+  }
+
+  // owner (64 bits) | epoch (64 bits)
+  static uint128_t claim_key(const name &owner, const uint64_t epoch)
+  {
+    return (uint128_t(owner.value) << 64) | epoch;
+  }
+
+  bool register_token(const name &contract, const symbol &sym);
+  static core::digest sha256_digest(const uint8_t *data, const size_t size)
+  {
+    return eosio::sha256(reinterpret_cast<const char *>(data), size).extract_as_byte_array();
+  }
+  static poolstat initial_stats(const pool &p);
+  const poolstat &find_stats(poolstats_cache &stats, const pool &p);
+  static poolstat read_stats(const name &pool_contract, const pool &p);
+  bool accrue_pool(poolstats_cache &stats, const pool &p, const poolstat &s, const uint32_t now_time);
+  static bool accrue(const pool &p, poolstat &s, const uint32_t now_time);
+  static uint64_t emitted(const pool &p, const uint32_t time);
+  const miner *find_miner(miners_cache &miners, const name &owner);
+  static bool read_miner(const name &pool_contract, const uint64_t pool_id, const name &owner, miner &m);
+  static vector<uint64_t> scan_positions(const name &pool_contract, const name &owner);
+  positions_mi::const_iterator find_position(positions_mi &positions_tbl, const name &owner);
+  void add_position(const name &owner, const uint64_t pool_id);
+  asset settle_claim(const poolstat &s, miners_cache &miners, const miner &m);
+  static uint128_t settled_debt(const poolstat &s, const miner &m, const int64_t new_staked);
+  static uint64_t pending_reward(const poolstat &s, const miner &m);
+  static asset get_balance(const name &token_contract, const name &owner, const symbol &sym);
 };
@@ -8,13 +8,24 @@ extern "C"
     {
       switch (action)
       {
-        EOSIO_DISPATCH_HELPER(xpool, (create)(claim)(harvest))
+        EOSIO_DISPATCH_HELPER(xpool, (create)(claim)(claimall)(harvest)(harvestall)(migrate)(sweepfees)(flushram)(getpending)(setroot)(claimproof)(logdeposit)(logharvest)(logclaim)(logpending))
       }
     }
     else
     {
       if (action == name("transfer").value)
       {
+        // from, to and quantity lead the transfer data, so unrelated
+        // transfers are turned away before the memo or any pool is read
+        uint64_t head[4];
+        if (read_action_data(head, sizeof(head)) == sizeof(head))
+        {
+          if (head[0] == receiver || head[1] != receiver)
+          {
+            return;
+          }
+          check(xpool::is_pool_token(name(receiver), name(code), symbol(head[3])), "Pool not found");
+        }
         xpool inst(name(receiver), name(code), datastream<const char *>(nullptr, 0));
         const auto t = unpack_action_data<transfer_args>();
         inst.handle_transfer(t.from, t.to, t.quantity, t.memo, name(code));
@@ -23,33 +34,29 @@ extern "C"
   }
 }
 
-void xpool::create(name contract, symbol sym, asset reward, uint32_t epoch_time, uint32_t duration, asset min_staked, uint8_t type)
+void xpool::create(name contract, symbol sym, asset reward, uint32_t epoch_time, uint32_t duration, asset min_staked, uint8_t type,
+                   binary_extension<vector<core::segment>> schedule)
 {
   require_auth(ADMIN);
+  const auto segments = schedule.value_or();
 
   pools_mi pools_tbl(_self, _self.value);
-  auto itr = pools_tbl.begin();
-
-  while (itr != pools_tbl.end())
-  {
-    auto exists = itr->contract == contract && itr->sym == sym && itr->type == type;
-    check(!exists, "Token exists");
-    itr++;
-  }
+  auto pools_idx = pools_tbl.get_index<"bytoken"_n>();
+  check(pools_idx.find(token_key(contract, sym, type)) == pools_idx.end(), "Token exists");
 
   check(reward.symbol == MINED_SYMBOL, "Reward symbol error");
   check(min_staked.symbol == sym, "Min staked symbol error");
   check(epoch_time > 0, "Invalid epoch");
   check(duration > 0, "Invalid duration");
+  check(type != POOL_TYPE_RAM || (contract == RAM_TOKEN && sym == RAM_SYMBOL), "RAM pool must stake EOS");
+  check(segments.empty() || core::valid_schedule(segments, epoch_time, epoch_time + duration, reward.amount), "Invalid schedule");
 
-  auto total = reward;
-  itr = pools_tbl.begin();
-  while (itr != pools_tbl.end())
-  {
-    total += itr->total_reward;
-    itr++;
-  }
-  check(total.amount <= MAX_SUPPLY, "Reach the max circulation");
+  global_singleton global_tbl(_self, _self.value);
+  auto state = global_tbl.get_or_default(global{asset(0, MINED_SYMBOL), 0});
+  state.allocated_reward += reward;
+  state.pool_count++;
+  check(state.allocated_reward.amount <= MAX_SUPPLY, "Reach the max circulation");
+  global_tbl.set(state, _self);
 
   auto pool_id = pools_tbl.available_primary_key();
   if (pool_id == 0)
@@ -68,7 +75,50 @@ void xpool::create(name contract, symbol sym, asset reward, uint32_t epoch_time,
     a.duration = duration;
     a.min_staked = min_staked;
     a.last_harvest_time = epoch_time;
+    a.acc_reward_per_share.emplace(0);
+    a.reward_dust.emplace(0);
+    a.schedule.emplace(segments);
+  });
+  poolstats_mi stats_tbl(_self, _self.value);
+  stats_tbl.emplace(_self, [&](auto &a) {
+    a.id = pool_id;
+    a.total_staked = 0;
+    a.released_reward = 0;
+    a.last_harvest_time = epoch_time;
+    a.acc_reward_per_share = 0;
+    a.reward_dust = 0;
+    a.distributed = 0;
+  });
+  register_token(contract, sym);
+}
+
+bool xpool::register_token(const name &contract, const symbol &sym)
+{
+  tokens_mi tokens_tbl(_self, _self.value);
+  auto t_itr = tokens_tbl.find(contract.value);
+  if (t_itr == tokens_tbl.end())
+  {
+    tokens_tbl.emplace(_self, [&](auto &a) {
+      a.contract = contract;
+      a.syms.push_back(sym);
+    });
+    return true;
+  }
+  if (std::find(t_itr->syms.begin(), t_itr->syms.end(), sym) != t_itr->syms.end())
+  {
+    return false;
+  }
+  tokens_tbl.modify(t_itr, same_payer, [&](auto &a) {
+    a.syms.push_back(sym);
   });
+  return true;
+}
+
+bool xpool::is_pool_token(const name &pool_contract, const name &contract, const symbol &sym)
+{
+  tokens_mi tokens_tbl(pool_contract, pool_contract.value);
+  auto t_itr = tokens_tbl.find(contract.value);
+  return t_itr != tokens_tbl.end() && std::find(t_itr->syms.begin(), t_itr->syms.end(), sym) != t_itr->syms.end();
 }
 
 void xpool::claim(name owner, uint64_t pool_id)
@@ -76,58 +126,417 @@ void xpool::claim(name owner, uint64_t pool_id)
   require_auth(owner);
 
   pools_mi pools_tbl(_self, _self.value);
-  auto p_itr = pools_tbl.require_find(pool_id, "Pool not exists");
-  miners_mi miners_tbl(_self, pool_id);
-  auto m_itr = miners_tbl.require_find(owner.value, "No this miner");
-  check(m_itr->unclaimed.amount > 0, "No unclaimed");
-
-  auto quantity = m_itr->unclaimed;
-  miners_tbl.modify(m_itr, same_payer, [&](auto &s) {
-    s.claimed += quantity;
-    s.unclaimed = asset(0, quantity.symbol);
-  });
+  const auto &p = pools_tbl.get(pool_id, "Pool not exists");
+  miners_cache miners(_self, pool_id);
+  auto m = find_miner(miners, owner);
+  check(m != nullptr, "No this miner");
+
+  poolstats_cache stats(_self, _self.value);
+  const auto &s = find_stats(stats, p);
+  accrue_pool(stats, p, s, current_time_point().sec_since_epoch());
+  auto quantity = settle_claim(s, miners, *m);
+  check(quantity.amount > 0, "No unclaimed");
 
   utils::inline_transfer(MINED_TOKEN, _self, owner, quantity, string("Minner claimed"));
 }
 
+void xpool::claimall(name owner)
+{
+  require_auth(owner);
+
+  pools_mi pools_tbl(_self, _self.value);
+  poolstats_cache stats(_self, _self.value);
+  positions_mi positions_tbl(_self, _self.value);
+  auto now_time = current_time_point().sec_since_epoch();
+  auto quantity = asset(0, MINED_SYMBOL);
+  for (const auto pool_id : find_position(positions_tbl, owner)->pool_ids)
+  {
+    const auto &p = pools_tbl.get(pool_id, "Pool not exists");
+    miners_cache miners(_self, pool_id);
+    auto m = find_miner(miners, owner);
+    check(m != nullptr, "No this miner");
+    const auto &s = find_stats(stats, p);
+    accrue_pool(stats, p, s, now_time);
+    quantity += settle_claim(s, miners, *m);
+  }
+  check(quantity.amount > 0, "No unclaimed");
+
+  utils::inline_transfer(MINED_TOKEN, _self, owner, quantity, string("Minner claimed"));
+}
+
+const xpool::miner *xpool::find_miner(miners_cache &miners, const name &owner)
+{
+  auto m = miners.find(owner.value);
+  if (m != nullptr)
+  {
+    return m;
+  }
+
+  miners_v0_mi legacy_tbl(_self, miners.get_scope());
+  auto l_itr = legacy_tbl.find(owner.value);
+  if (l_itr == legacy_tbl.end())
+  {
+    return nullptr;
+  }
+
+  const auto &row = miners.emplace(_self, [&](auto &a) {
+    a.owner = l_itr->owner;
+    a.staked = l_itr->staked.amount;
+    a.claimed = l_itr->claimed.amount;
+    a.unclaimed = l_itr->unclaimed.amount;
+    // a legacy pool's accumulator starts at 0, so the stake has nothing settled yet
+    a.reward_debt = 0;
+  });
+  legacy_tbl.erase(l_itr);
+  return &row;
+}
+
+bool xpool::read_miner(const name &pool_contract, const uint64_t pool_id, const name &owner, miner &m)
+{
+  miners_mi miners_tbl(pool_contract, pool_id);
+  auto m_itr = miners_tbl.find(owner.value);
+  if (m_itr != miners_tbl.end())
+  {
+    m = *m_itr;
+    return true;
+  }
+
+  miners_v0_mi legacy_tbl(pool_contract, pool_id);
+  auto l_itr = legacy_tbl.find(owner.value);
+  if (l_itr != legacy_tbl.end())
+  {
+    m = miner{l_itr->owner, l_itr->staked.amount, l_itr->claimed.amount, l_itr->unclaimed.amount, 0};
+    return true;
+  }
+  return false;
+}
+
+vector<uint64_t> xpool::scan_positions(const name &pool_contract, const name &owner)
+{
+  pools_mi pools_tbl(pool_contract, pool_contract.value);
+  vector<uint64_t> pool_ids;
+  miner m;
+  for (auto p_itr = pools_tbl.begin(); p_itr != pools_tbl.end(); p_itr++)
+  {
+    if (read_miner(pool_contract, p_itr->id, owner, m))
+    {
+      pool_ids.push_back(p_itr->id);
+    }
+  }
+  return pool_ids;
+}
+
+vector<uint64_t> xpool::get_positions(const name &pool_contract, const name &owner)
+{
+  positions_mi positions_tbl(pool_contract, pool_contract.value);
+  auto itr = positions_tbl.find(owner.value);
+  return itr == positions_tbl.end() ? scan_positions(pool_contract, owner) : itr->pool_ids;
+}
+
+// owners who staked before positions existed get their row from one scan of all pools
+xpool::positions_mi::const_iterator xpool::find_position(positions_mi &positions_tbl, const name &owner)
+{
+  auto itr = positions_tbl.find(owner.value);
+  if (itr != positions_tbl.end())
+  {
+    return itr;
+  }
+  return positions_tbl.emplace(_self, [&](auto &a) {
+    a.owner = owner;
+    a.pool_ids = scan_positions(_self, owner);
+  });
+}
+
+void xpool::add_position(const name &owner, const uint64_t pool_id)
+{
+  positions_mi positions_tbl(_self, _self.value);
+  auto itr = find_position(positions_tbl, owner);
+  if (std::find(itr->pool_ids.begin(), itr->pool_ids.end(), pool_id) == itr->pool_ids.end())
+  {
+    positions_tbl.modify(itr, same_payer, [&](auto &a) {
+      a.pool_ids.push_back(pool_id);
+    });
+  }
+}
+
+xpool::miner_info xpool::get_miner(const name &pool_contract, const uint64_t pool_id, const name &owner)
+{
+  pools_mi pools_tbl(pool_contract, pool_contract.value);
+  const auto &p = pools_tbl.get(pool_id, "Pool not exists");
+  auto s = read_stats(pool_contract, p);
+  accrue(p, s, current_time_point().sec_since_epoch());
+
+  miner m;
+  check(read_miner(pool_contract, pool_id, owner, m), "No this miner");
+  return {owner, asset(m.staked, p.sym), asset(m.claimed, MINED_SYMBOL), asset(m.unclaimed, MINED_SYMBOL),
+          asset(pending_reward(s, m), MINED_SYMBOL)};
+}
+
+vector<xpool::pool_pending> xpool::get_pending(const name &pool_contract, const name &owner, const vector<uint64_t> &pool_ids)
+{
+  pools_mi pools_tbl(pool_contract, pool_contract.value);
+  auto now_time = current_time_point().sec_since_epoch();
+  vector<pool_pending> result;
+  result.reserve(pool_ids.size());
+  for (const auto pool_id : pool_ids)
+  {
+    // accrued on a copy, the poolstats row is left as it is
+    const auto &p = pools_tbl.get(pool_id, "Pool not exists");
+    auto s = read_stats(pool_contract, p);
+    accrue(p, s, now_time);
+
+    auto quantity = asset(0, MINED_SYMBOL);
+    miner m;
+    if (read_miner(pool_contract, pool_id, owner, m))
+    {
+      quantity.amount = safemath::add(m.unclaimed, pending_reward(s, m));
+    }
+    result.push_back({pool_id, quantity});
+  }
+  return result;
+}
+
+void xpool::getpending(name owner, vector<uint64_t> pool_ids)
+{
+  check(!pool_ids.empty(), "No pools");
+
+  logpending_action logpending(_self, {_self, "active"_n});
+  logpending.send(owner, get_pending(_self, owner, pool_ids));
+}
+
+asset xpool::settle_claim(const poolstat &s, miners_cache &miners, const miner &m)
+{
+  auto quantity = asset(m.unclaimed, MINED_SYMBOL);
+  quantity.amount = safemath::add(quantity.amount, pending_reward(s, m));
+  if (quantity.amount > 0)
+  {
+    auto reward_debt = settled_debt(s, m, m.staked);
+    miners.modify(m, [&](auto &a) {
+      a.claimed = safemath::add(a.claimed, quantity.amount);
+      a.unclaimed = 0;
+      a.reward_debt = reward_debt;
+    });
+
+    logclaim_action logclaim(_self, {_self, "active"_n});
+    logclaim.send(m.owner, s.id, quantity);
+  }
+  return quantity;
+}
+
+void xpool::setroot(uint64_t pool_id, uint64_t epoch, checksum256 root, asset total)
+{
+  require_auth(ADMIN);
+
+  pools_mi pools_tbl(_self, _self.value);
+  const auto &p = pools_tbl.get(pool_id, "Pool not exists");
+  check(total.symbol == MINED_SYMBOL, "Reward symbol error");
+  check(total.amount > 0, "Invalid total");
+
+  distributions_mi dist_tbl(_self, pool_id);
+  check(dist_tbl.find(epoch) == dist_tbl.end(), "Root exists");
+
+  // the first root settles accrual up to now and the pool pays only through
+  // roots from then on, so roots and accrual never share out the same reward
+  poolstats_cache stats(_self, _self.value);
+  const auto &s = find_stats(stats, p);
+  accrue_pool(stats, p, s, current_time_point().sec_since_epoch());
+  const auto distributed = safemath::add(s.distributed, total.amount);
+  check(distributed <= p.total_reward.amount - s.released_reward, "Distribution exceeds unreleased reward");
+  stats.modify(s, [&](auto &a) {
+    a.distributed = distributed;
+  });
+
+  dist_tbl.emplace(_self, [&](auto &a) {
+    a.epoch = epoch;
+    a.root = root;
+    a.total = total;
+    a.claimed = asset(0, MINED_SYMBOL);
+  });
+}
+
+void xpool::claimproof(name owner, uint64_t pool_id, uint64_t epoch, asset amount, vector<checksum256> proof)
+{
+  require_auth(owner);
+  check(amount.symbol == MINED_SYMBOL && amount.amount > 0, "Invalid amount");
+
+  distributions_mi dist_tbl(_self, pool_id);
+  const auto &d = dist_tbl.get(epoch, "Root not exists");
+  proofclaims_mi claims_tbl(_self, pool_id);
+  auto claims_idx = claims_tbl.get_index<"byclaim"_n>();
+  check(claims_idx.find(claim_key(owner, epoch)) == claims_idx.end(), "Already claimed");
+
+  const auto leaf = core::leaf_message(owner.value, pool_id, epoch, uint64_t(amount.amount));
+  auto node = sha256_digest(leaf.data(), leaf.size());
+  for (const auto &sibling : proof)
+  {
+    node = core::hash_pair(node, sibling.extract_as_byte_array(), sha256_digest);
+  }
+  check(node == d.root.extract_as_byte_array(), "Invalid proof");
+  check(d.claimed + amount <= d.total, "Distribution exhausted");
+
+  dist_tbl.modify(d, same_payer, [&](auto &a) {
+    a.claimed += amount;
+  });
+  // one fixed-size row per claim, paid for by the claimant
+  claims_tbl.emplace(owner, [&](auto &a) {
+    a.id = claims_tbl.available_primary_key();
+    a.owner = owner;
+    a.epoch = epoch;
+  });
+
+  logclaim_action logclaim(_self, {_self, "active"_n});
+  logclaim.send(owner, pool_id, amount);
+  utils::inline_transfer(MINED_TOKEN, _self, owner, amount, string("Minner claimed"));
+}
+
 void xpool::harvest(uint64_t pool_id, uint32_t nonce)
 {
   require_auth(ADMIN);
 
   pools_mi pools_tbl(_self, _self.value);
-  auto itr = pools_tbl.require_find(pool_id, "Pool not exists");
+  const auto &p = pools_tbl.get(pool_id, "Pool not exists");
 
   auto now_time = current_time_point().sec_since_epoch();
-  check(now_time >= itr->epoch_time, "Mining hasn't started yet");
-  check(now_time <= itr->epoch_time + itr->duration, "Mining is over");
-  check(itr->total_staked.amount > 0, "No staked tokens");
-
-  auto supply_per_second = safemath::div(itr->total_reward.amount, uint64_t(itr->duration));
-  auto time_elapsed = now_time - itr->last_harvest_time;
-  auto token_issued = asset(safemath::mul(uint64_t(time_elapsed), supply_per_second), itr->released_reward.symbol);
-  pools_tbl.modify(itr, same_payer, [&](auto &s) {
-    s.released_reward += token_issued;
-    s.last_harvest_time = now_time;
-  });
+  check(now_time >= p.epoch_time, "Mining hasn't started yet");
+  check(now_time <= p.epoch_time + p.duration, "Mining is over");
+  poolstats_cache stats(_self, _self.value);
+  const auto &s = find_stats(stats, p);
+  check(s.distributed == 0, "Pool pays through merkle roots");
+  check(s.total_staked > 0, "No staked tokens");
+
+  // deposits and claims accrue on their own; this only brings the poolstats row up to date
+  accrue_pool(stats, p, s, now_time);
 
   // issue
   // auto data = make_tuple(_self, token_issued, string("Issue Token"));
   // action(permission_level{_self, "active"_n}, MINED_TOKEN, "issue"_n, data).send();
+}
+
+void xpool::harvestall(uint32_t nonce)
+{
+  require_auth(ADMIN);
+
+  // pools that have not started, have been accrued to their end, have
+  // nothing staked or pay through merkle roots are left alone instead of
+  // failing the batch
+  pools_mi pools_tbl(_self, _self.value);
+  poolstats_cache stats(_self, _self.value);
+  auto now_time = current_time_point().sec_since_epoch();
+  for (auto itr = pools_tbl.begin(); itr != pools_tbl.end(); itr++)
+  {
+    const auto &s = find_stats(stats, *itr);
+    if (now_time > s.last_harvest_time && s.total_staked > 0 && s.distributed == 0)
+    {
+      accrue_pool(stats, *itr, s, now_time);
+    }
+  }
+}
+
+void xpool::migrate()
+{
+  require_auth(ADMIN);
+
+  // rows written before the bytoken index existed have no secondary entry,
+  // so rewrite them through the index-aware table
+  pools_legacy_mi legacy_tbl(_self, _self.value);
+  pools_mi pools_tbl(_self, _self.value);
+  auto pools_idx = pools_tbl.get_index<"bytoken"_n>();
+  vector<pool_v0> rows;
+  for (auto itr = legacy_tbl.begin(); itr != legacy_tbl.end(); itr++)
+  {
+    auto idx_itr = pools_idx.find(token_key(itr->contract, itr->sym, itr->type));
+    if (idx_itr == pools_idx.end() || idx_itr->id != itr->id)
+    {
+      rows.push_back(*itr);
+    }
+  }
+
+  // deployments older than the global singleton get it rebuilt from the pools
+  global_singleton global_tbl(_self, _self.value);
+  auto rebuild_global = !global_tbl.exists();
+
+  // deployments older than the token registry get it filled from the pools
+  auto registered = false;
+  for (auto itr = legacy_tbl.begin(); itr != legacy_tbl.end(); itr++)
+  {
+    registered = register_token(itr->contract, itr->sym) || registered;
+  }
+  check(!rows.empty() || rebuild_global || registered, "Nothing to migrate");
+
+  if (rebuild_global)
+  {
+    auto state = global{asset(0, MINED_SYMBOL), 0};
+    for (auto itr = legacy_tbl.begin(); itr != legacy_tbl.end(); itr++)
+    {
+      state.allocated_reward += itr->total_reward;
+      state.pool_count++;
+    }
+    global_tbl.set(state, _self);
+  }
 
-  // update every miner
-  miners_mi miners_tbl(_self, itr->id);
-  auto m_itr = miners_tbl.begin();
-  check(m_itr != miners_tbl.end(), "No miners");
-  while (m_itr != miners_tbl.end())
-  {
-    double radio = (double)(m_itr->staked.amount) / itr->total_staked.amount;
-    uint64_t amount = (uint64_t)(token_issued.amount * radio);
-    check(amount >= 0, "invalid amount");
-    uint64_t unclaimed = safemath::add(m_itr->unclaimed.amount, amount);
-    miners_tbl.modify(m_itr, same_payer, [&](auto &a) {
-      a.unclaimed.amount = unclaimed;
+  for (const auto &row : rows)
+  {
+    legacy_tbl.erase(legacy_tbl.require_find(row.id, "Pool not exists"));
+    pools_tbl.emplace(_self, [&](auto &a) {
+      a.id = row.id;
+      a.type = row.type;
+      a.contract = row.contract;
+      a.sym = row.sym;
+      a.total_staked = row.total_staked;
+      a.total_reward = row.total_reward;
+      a.released_reward = row.released_reward;
+      a.epoch_time = row.epoch_time;
+      a.duration = row.duration;
+      a.min_staked = row.min_staked;
+      a.last_harvest_time = row.last_harvest_time;
+      a.acc_reward_per_share.emplace(0);
+      a.reward_dust.emplace(0);
+      a.schedule.emplace();
     });
-    m_itr++;
+  }
+}
+
+void xpool::sweepfees(name contract, symbol sym)
+{
+  fees_mi fees_tbl(_self, contract.value);
+  auto itr = fees_tbl.find(sym.code().raw());
+  check(itr != fees_tbl.end() && itr->balance.amount > 0, "No fees");
+  check(itr->balance.symbol == sym, "Error token");
+
+  auto quantity = itr->balance;
+  fees_tbl.modify(itr, same_payer, [&](auto &a) {
+    a.balance.amount = 0;
+  });
+
+  utils::inline_transfer(contract, _self, FUND, quantity, string("Dev Rewards"));
+}
+
+void xpool::flushram(uint32_t limit)
+{
+  check(limit > 0, "Invalid limit");
+
+  ramorders_mi orders_tbl(_self, _self.value);
+  auto itr = orders_tbl.begin();
+  check(itr != orders_tbl.end(), "No queued RAM");
+
+  global_singleton global_tbl(_self, _self.value);
+  auto state = global_tbl.get_or_default(global{asset(0, MINED_SYMBOL), 0});
+  auto now_time = current_time_point().sec_since_epoch();
+  check(now_time >= state.last_ram_flush + RAM_BATCH_WINDOW, "RAM batch window not reached");
+
+  // buyram takes a single receiver, so deposits are coalesced per depositor
+  while (itr != orders_tbl.end() && limit > 0)
+  {
+    utils::buyram(_self, itr->owner, itr->quantity);
+    itr = orders_tbl.erase(itr);
+    limit--;
+  }
+
+  // a partial flush leaves the window open so the rest can follow right away
+  if (itr == orders_tbl.end())
+  {
+    state.last_ram_flush = now_time;
+    global_tbl.set(state, _self);
   }
 }
 
@@ -139,50 +548,210 @@ void xpool::handle_transfer(name from, name to, asset quantity, string memo, nam
   }
   require_auth(from);
   auto sym = quantity.symbol;
+  const bool fee_only = memo == FEE_ONLY_MEMO;
   pools_mi pools_tbl(_self, _self.value);
-  auto itr = pools_tbl.begin();
+  auto pools_idx = pools_tbl.get_index<"bytoken"_n>();
   uint8_t type = memo == "1" ? POOL_TYPE_RAM : POOL_TYPE_NORMAL;
-  while (itr != pools_tbl.end())
-  {
-    if (itr->contract == code && itr->sym == sym && itr->type == type)
-    {
-      break;
-    }
-    itr++;
-  }
-  check(itr != pools_tbl.end(), "Pool not found");
-  check(itr->contract == code && itr->sym == sym, "Error token");
-  check(quantity >= itr->min_staked, "The amount of staked is too small");
+  auto idx_itr = pools_idx.find(token_key(code, sym, type));
+  check(idx_itr != pools_idx.end(), "Pool not found");
+  check(idx_itr->contract == code && idx_itr->sym == sym, "Error token");
+  const auto &p = *idx_itr;
+  const auto split = fee_only ? core::split_fee(quantity.amount) : core::split_deposit(quantity.amount);
+  const auto to_dev = asset(split.to_dev, quantity.symbol);
+  const auto to_stake = asset(split.to_stake, quantity.symbol);
+  check(to_dev + to_stake >= p.min_staked, "The amount of staked is too small");
   auto now_time = current_time_point().sec_since_epoch();
-  check(now_time <= itr->epoch_time + itr->duration, "Mining is over");
+  check(now_time <= p.epoch_time + p.duration, "Mining is over");
+  poolstats_cache stats(_self, _self.value);
+  const auto &s = find_stats(stats, p);
+  accrue_pool(stats, p, s, now_time);
+  // written back together with the accrual when stats goes out of scope
+  stats.modify(s, [&](auto &a) {
+    a.total_staked = safemath::add(a.total_staked, to_stake.amount);
+  });
   /**
   add code here
   **/
-  auto ratio = 10;
-  const auto to_dev = asset(safemath::div(quantity.amount, uint64_t(ratio)), quantity.symbol); // 10% To Dev
-  const auto to_stake = quantity - to_dev;                                                  // 90% To Pool
-  utils::inline_transfer(code, _self, from, to_stake, string("refund"));
-  utils::inline_transfer(code, _self, FUND, to_dev, string("Dev Rewards"));
-  pools_tbl.modify(itr, same_payer, [&](auto &s) {
-    s.total_staked += to_stake;
-  });
+  if (fee_only)
+  {
+    // nothing to refund, the stake never left the depositor
+    check(get_balance(code, from, sym) >= to_stake, "Insufficient balance for the stake");
+  }
+  else if (p.type == POOL_TYPE_RAM)
+  {
+    // converted to RAM for the depositor by the next flushram
+    ramorders_mi orders_tbl(_self, _self.value);
+    auto o_itr = orders_tbl.find(from.value);
+    if (o_itr == orders_tbl.end())
+    {
+      orders_tbl.emplace(_self, [&](auto &a) {
+        a.owner = from;
+        a.quantity = to_stake;
+      });
+    }
+    else
+    {
+      orders_tbl.modify(o_itr, same_payer, [&](auto &a) {
+        a.quantity += to_stake;
+      });
+    }
+  }
+  else
+  {
+    utils::inline_transfer(code, _self, from, to_stake, string("refund"));
+  }
 
-  miners_mi miners_tbl(_self, itr->id);
-  auto m_itr = miners_tbl.find(from.value);
-  if (m_itr == miners_tbl.end())
+  // dev fees stay in the contract until sweepfees sends them to FUND
+  fees_mi fees_tbl(_self, code.value);
+  auto f_itr = fees_tbl.find(sym.code().raw());
+  if (f_itr == fees_tbl.end())
+  {
+    fees_tbl.emplace(_self, [&](auto &a) {
+      a.balance = to_dev;
+    });
+  }
+  else
+  {
+    fees_tbl.modify(f_itr, same_payer, [&](auto &a) {
+      a.balance += to_dev;
+    });
+  }
+  miners_cache miners(_self, p.id);
+  auto m = find_miner(miners, from);
+  auto settled = asset(0, MINED_SYMBOL);
+  if (m == nullptr)
   {
-    auto zero = asset(0, MINED_SYMBOL);
-    miners_tbl.emplace(_self, [&](auto &a) {
+    add_position(from, p.id);
+    miners.emplace(_self, [&](auto &a) {
       a.owner = from;
-      a.staked = to_stake;
-      a.claimed = zero;
-      a.unclaimed = zero;
+      a.staked = to_stake.amount;
+      a.claimed = 0;
+      a.unclaimed = 0;
+      a.reward_debt = core::scaled_reward(s.acc_reward_per_share, to_stake.amount);
     });
   }
   else
   {
-    miners_tbl.modify(m_itr, same_payer, [&](auto &a) {
-      a.staked += to_stake;
+    auto staked = safemath::add(m->staked, to_stake.amount);
+    settled.amount = pending_reward(s, *m);
+    auto reward_debt = settled_debt(s, *m, staked);
+    miners.modify(*m, [&](auto &a) {
+      a.staked = staked;
+      a.unclaimed = safemath::add(a.unclaimed, settled.amount);
+      a.reward_debt = reward_debt;
     });
   }
+
+  logdeposit_action logdeposit(_self, {_self, "active"_n});
+  logdeposit.send(from, p.id, to_stake, to_dev, settled);
+}
+
+asset xpool::get_balance(const name &token_contract, const name &owner, const symbol &sym)
+{
+  token_accounts_mi accounts_tbl(token_contract, owner.value);
+  auto a_itr = accounts_tbl.find(sym.code().raw());
+  return a_itr == accounts_tbl.end() ? asset(0, sym) : a_itr->balance;
+}
+
+// pools created before poolstats keep their counters in the pool row
+xpool::poolstat xpool::initial_stats(const pool &p)
+{
+  return {p.id, p.total_staked.amount, p.released_reward.amount, p.last_harvest_time, p.acc_reward_per_share.value_or(),
+          p.reward_dust.value_or(), 0};
+}
+
+const xpool::poolstat &xpool::find_stats(poolstats_cache &stats, const pool &p)
+{
+  auto s = stats.find(p.id);
+  if (s != nullptr)
+  {
+    return *s;
+  }
+  return stats.emplace(_self, [&](auto &a) {
+    a = initial_stats(p);
+  });
+}
+
+xpool::poolstat xpool::read_stats(const name &pool_contract, const pool &p)
+{
+  poolstats_mi stats_tbl(pool_contract, pool_contract.value);
+  auto s_itr = stats_tbl.find(p.id);
+  return s_itr == stats_tbl.end() ? initial_stats(p) : *s_itr;
+}
+
+bool xpool::accrue_pool(poolstats_cache &stats, const pool &p, const poolstat &s, const uint32_t now_time)
+{
+  auto accrued = s;
+  if (!accrue(p, accrued, now_time))
+  {
+    return false;
+  }
+  logharvest_action logharvest(_self, {_self, "active"_n});
+  logharvest.send(p.id, asset(accrued.released_reward - s.released_reward, MINED_SYMBOL), accrued.acc_reward_per_share, accrued.last_harvest_time);
+  stats.modify(s, [&](auto &a) {
+    a = accrued;
+  });
+  return true;
+}
+
+// core::accrue_pool over the poolstats row, see there; pools paying
+// through merkle roots stay where setroot left them
+bool xpool::accrue(const pool &p, poolstat &s, const uint32_t now_time)
+{
+  if (s.distributed > 0)
+  {
+    return false;
+  }
+
+  auto counters = core::pool_counters{uint64_t(s.total_staked), uint64_t(s.released_reward), s.last_harvest_time,
+                                      {s.acc_reward_per_share, s.reward_dust}};
+  if (!core::accrue_pool(counters, p.epoch_time + p.duration, now_time, [&](const uint32_t time) { return emitted(p, time); }))
+  {
+    return false;
+  }
+
+  s.released_reward = int64_t(counters.released_reward);
+  s.last_harvest_time = counters.last_harvest_time;
+  s.acc_reward_per_share = counters.acc.acc_reward_per_share;
+  s.reward_dust = counters.acc.reward_dust;
+  return true;
+}
+
+uint64_t xpool::emitted(const pool &p, const uint32_t time)
+{
+  if (p.schedule.has_value() && !p.schedule.value().empty())
+  {
+    return core::emitted(p.schedule.value(), time);
+  }
+  return core::emitted(core::segment{p.epoch_time, p.epoch_time + p.duration, uint64_t(p.total_reward.amount)}, time);
+}
+
+uint128_t xpool::settled_debt(const poolstat &s, const miner &m, const int64_t new_staked)
+{
+  return core::reward_debt(s.acc_reward_per_share, m.staked, m.reward_debt, new_staked);
+}
+
+uint64_t xpool::pending_reward(const poolstat &s, const miner &m)
+{
+  return core::pending_reward(s.acc_reward_per_share, m.staked, m.reward_debt, MAX_SUPPLY);
+}
+
+void xpool::logdeposit(name owner, uint64_t pool_id, asset staked, asset fee, asset settled)
+{
+  require_auth(_self);
+}
+
+void xpool::logharvest(uint64_t pool_id, asset released, uint128_t acc_reward_per_share, uint32_t harvest_time)
+{
+  require_auth(_self);
+}
+
+void xpool::logclaim(name owner, uint64_t pool_id, asset quantity)
+{
+  require_auth(_self);
+}
+
+void xpool::logpending(name owner, vector<pool_pending> pending)
+{
+  require_auth(_self);
 }
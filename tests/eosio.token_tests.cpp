@@ -89,6 +89,18 @@ public:
     return push_action(from, N(transfer), mvo()("from", from)("to", to)("quantity", quantity)("memo", memo));
   }
 
+  action_result transfermany(account_name from,
+                             const vector<std::pair<account_name, asset>> &transfers,
+                             string memo)
+  {
+    fc::variants args;
+    for (const auto &t : transfers)
+    {
+      args.push_back(mvo()("first", t.first)("second", t.second));
+    }
+    return push_action(from, N(transfermany), mvo()("from", from)("transfers", args)("memo", memo));
+  }
+
   action_result open(account_name owner,
                      const string &symbolname,
                      account_name ram_payer)
@@ -282,6 +294,41 @@ try
 }
 FC_LOG_AND_RETHROW()
 
+BOOST_FIXTURE_TEST_CASE(transfermany_tests, eosio_token_tester)
+try
+{
+
+  auto token = create(N(alice), asset::from_string("1000 CERO"));
+  produce_blocks(1);
+
+  issue(N(alice), asset::from_string("1000 CERO"), "hola");
+
+  BOOST_REQUIRE_EQUAL(success(),
+                      transfermany(N(alice), {{N(bob), asset::from_string("300 CERO")}, {N(carol), asset::from_string("200 CERO")}, {N(bob), asset::from_string("100 CERO")}}, "hola"));
+
+  auto alice_balance = get_account(N(alice), "0,CERO");
+  REQUIRE_MATCHING_OBJECT(alice_balance, mvo()("balance", "400 CERO"));
+
+  auto bob_balance = get_account(N(bob), "0,CERO");
+  REQUIRE_MATCHING_OBJECT(bob_balance, mvo()("balance", "400 CERO"));
+
+  auto carol_balance = get_account(N(carol), "0,CERO");
+  REQUIRE_MATCHING_OBJECT(carol_balance, mvo()("balance", "200 CERO"));
+
+  BOOST_REQUIRE_EQUAL(wasm_assert_msg("no transfers"),
+                      transfermany(N(alice), {}, "hola"));
+
+  BOOST_REQUIRE_EQUAL(wasm_assert_msg("overdrawn balance"),
+                      transfermany(N(alice), {{N(bob), asset::from_string("300 CERO")}, {N(carol), asset::from_string("101 CERO")}}, "hola"));
+
+  BOOST_REQUIRE_EQUAL(wasm_assert_msg("cannot transfer to self"),
+                      transfermany(N(alice), {{N(bob), asset::from_string("1 CERO")}, {N(alice), asset::from_string("1 CERO")}}, "hola"));
+
+  BOOST_REQUIRE_EQUAL(wasm_assert_msg("must transfer positive quantity"),
+                      transfermany(N(alice), {{N(bob), asset::from_string("-1 CERO")}}, "hola"));
+}
+FC_LOG_AND_RETHROW()
+
 BOOST_FIXTURE_TEST_CASE(open_tests, eosio_token_tester)
 try
 {
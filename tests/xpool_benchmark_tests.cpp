@@ -0,0 +1,202 @@
+#include "xpool_tester.hpp"
+
+#include <cstdlib>
+
+// Resource usage of the xpool actions as the number of miners grows. Every
+// measured transaction is billed by the chain (no fixed test billing),
+// logged, and appended to the CSV file XPOOL_BENCHMARK_CSV, or to
+// ./xpool_benchmark.csv when it is unset. The 10 miner case runs with the
+// rest of unit_test; the larger pools take minutes, so they are skipped
+// unless XPOOL_BENCHMARK is set.
+
+static boost::test_tools::assertion_result benchmark_enabled(boost::unit_test::test_unit_id)
+{
+  boost::test_tools::assertion_result result(std::getenv("XPOOL_BENCHMARK") != nullptr);
+  result.message() << "set XPOOL_BENCHMARK to run it";
+  return result;
+}
+
+class xpool_benchmark_tester : public xpool_tester
+{
+public:
+  struct usage
+  {
+    uint32_t cpu_us;
+    uint32_t net_bytes;
+    int64_t ram_delta;
+  };
+
+  static name miner_name(uint32_t index)
+  {
+    static const char *charmap = "12345abcdefghijklmnopqrstuvwxyz";
+    string suffix;
+    for (int i = 0; i < 4; i++)
+    {
+      suffix = charmap[index % 31] + suffix;
+      index /= 31;
+    }
+    return name("benchm" + suffix);
+  }
+
+  void create_miners(uint32_t count)
+  {
+    const uint32_t batch = 20;
+    for (uint32_t first = 0; first < count; first += batch)
+    {
+      signed_transaction trx;
+      for (uint32_t i = first; i < std::min(count, first + batch); i++)
+      {
+        const auto a = miner_name(i);
+        trx.actions.emplace_back(vector<permission_level>{{config::system_account_name, config::active_name}},
+                                 newaccount{
+                                     .creator = config::system_account_name,
+                                     .name = a,
+                                     .owner = authority(get_public_key(a, "owner")),
+                                     .active = authority(get_public_key(a, "active"))});
+        trx.actions.emplace_back(get_action(config::system_account_name, N(buyram), vector<permission_level>{{config::system_account_name, config::active_name}},
+                                            mvo()("payer", config::system_account_name)("receiver", a)("quant", core_sym::from_string("10.0000"))));
+        trx.actions.emplace_back(get_action(config::system_account_name, N(delegatebw), vector<permission_level>{{config::system_account_name, config::active_name}},
+                                            mvo()("from", config::system_account_name)("receiver", a)("stake_net_quantity", core_sym::from_string("10.0000"))("stake_cpu_quantity", core_sym::from_string("10.0000"))("transfer", 0)));
+        trx.actions.emplace_back(get_action(N(eosio.token), N(transfer), vector<permission_level>{{config::system_account_name, config::active_name}},
+                                            mvo()("from", config::system_account_name)("to", a)("quantity", core_sym::from_string("100.0000"))("memo", "")));
+      }
+      set_transaction_headers(trx);
+      trx.sign(get_private_key(config::system_account_name, "active"), control->get_chain_id());
+      push_transaction(trx);
+      produce_block();
+    }
+  }
+
+  usage measure(name code, name act, name actor, const variant_object &data)
+  {
+    signed_transaction trx;
+    trx.actions.emplace_back(get_action(code, act, vector<permission_level>{{actor, config::active_name}}, data));
+    set_transaction_headers(trx);
+    trx.sign(get_private_key(actor, "active"), control->get_chain_id());
+    // billed_cpu_time_us = 0 lets the chain bill the measured CPU time
+    auto trace = push_transaction(trx, fc::time_point::maximum(), 0);
+    produce_block();
+
+    usage u{trace->receipt->cpu_usage_us, trace->receipt->net_usage_words * 8, 0};
+    for (const auto &at : trace->action_traces)
+    {
+      for (const auto &d : at.account_ram_deltas)
+      {
+        u.ram_delta += d.delta;
+      }
+    }
+    return u;
+  }
+
+  void record(const string &action, uint32_t miners, const usage &u)
+  {
+    BOOST_TEST_MESSAGE(action << " with " << miners << " miners: " << u.cpu_us << " us cpu, " << u.net_bytes << " net bytes, "
+                              << u.ram_delta << " ram bytes");
+    const char *path = std::getenv("XPOOL_BENCHMARK_CSV");
+    const string file = path != nullptr ? path : "xpool_benchmark.csv";
+    const bool empty = !fc::exists(file) || fc::file_size(file) == 0;
+    std::ofstream out(file, std::ios::app);
+    if (empty)
+    {
+      out << "action,miners,cpu_us,net_bytes,ram_delta\n";
+    }
+    out << action << "," << miners << "," << u.cpu_us << "," << u.net_bytes << "," << u.ram_delta << "\n";
+  }
+
+  // harvest and claim touch one poolstats row and one miner row, so what they
+  // cost must not depend on how many miners the pool has
+  static void check_flat(const usage &few, const usage &many)
+  {
+    BOOST_REQUIRE_EQUAL(few.net_bytes, many.net_bytes);
+    BOOST_REQUIRE_EQUAL(few.ram_delta, many.ram_delta);
+    // CPU is measured, so only growth well beyond timing noise fails
+    BOOST_REQUIRE_LE(many.cpu_us, 3 * few.cpu_us + 200);
+  }
+
+  usage deposit_miners(uint32_t first, uint32_t last)
+  {
+    usage deposit{};
+    for (uint32_t i = first; i < last; i++)
+    {
+      const auto owner = miner_name(i);
+      deposit = measure(N(eosio.token), N(transfer), owner, mvo()("from", owner)("to", N(rabbitspoolx))("quantity", "10.0000 EOS")("memo", ""));
+    }
+    return deposit;
+  }
+
+  void run(uint32_t miners)
+  {
+    const uint32_t epoch = control->head_block_time().sec_since_epoch();
+    const uint32_t duration = 604800;
+    // room for every miner row
+    base_tester::push_action(config::system_account_name, N(buyram), config::system_account_name,
+                             mvo()("payer", config::system_account_name)("receiver", N(rabbitspoolx))("quant", core_sym::from_string("10000.0000")));
+
+    record("create", miners, measure(N(rabbitspoolx), N(create), N(rabbitsadmin),
+                                     mvo()("contract", N(eosio.token))("sym", "4,EOS")("reward", "13000.0000 CAT")("epoch_time", epoch)("duration", duration)("min_staked", "1.0000 EOS")("type", 0)));
+
+    create_miners(miners);
+
+    // harvest and claim with a few miners, as the baseline for the full pool
+    const uint32_t few = std::min<uint32_t>(miners, 10);
+    auto deposit = deposit_miners(0, few);
+    produce_blocks(10 * 2);
+    const auto few_harvest = measure(N(rabbitspoolx), N(harvest), N(rabbitsadmin), mvo()("pool_id", 1)("nonce", 1));
+    const auto few_claim = measure(N(rabbitspoolx), N(claim), miner_name(0), mvo()("owner", miner_name(0))("pool_id", 1));
+
+    // the deposit that brought the pool to `miners` stakers
+    if (miners > few)
+    {
+      deposit = deposit_miners(few, miners);
+    }
+    record("handle_transfer", miners, deposit);
+
+    produce_blocks(10 * 2);
+    const auto harvest = measure(N(rabbitspoolx), N(harvest), N(rabbitsadmin), mvo()("pool_id", 1)("nonce", 2));
+    const auto claim = measure(N(rabbitspoolx), N(claim), miner_name(0), mvo()("owner", miner_name(0))("pool_id", 1));
+    record("harvest", miners, harvest);
+    record("claim", miners, claim);
+    check_flat(few_harvest, harvest);
+    check_flat(few_claim, claim);
+
+    // XPOOL_SNAPSHOT_JSONL keeps the final tables for tools/xpool-snapshot
+    if (const char *path = std::getenv("XPOOL_SNAPSHOT_JSONL"))
+    {
+      std::ofstream out(path, std::ios::trunc);
+      dump_tables(N(rabbitspoolx), abi_xpool_ser, out);
+      dump_tables(N(eosio.token), abi_token_ser, out);
+    }
+  }
+};
+
+BOOST_AUTO_TEST_SUITE(xpool_benchmark_tests)
+
+BOOST_FIXTURE_TEST_CASE(benchmark_10_miners, xpool_benchmark_tester)
+try
+{
+  run(10);
+}
+FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE(benchmark_100_miners, xpool_benchmark_tester, *boost::unit_test::precondition(benchmark_enabled))
+try
+{
+  run(100);
+}
+FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE(benchmark_1000_miners, xpool_benchmark_tester, *boost::unit_test::precondition(benchmark_enabled))
+try
+{
+  run(1000);
+}
+FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE(benchmark_10000_miners, xpool_benchmark_tester, *boost::unit_test::precondition(benchmark_enabled))
+try
+{
+  run(10000);
+}
+FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_SUITE_END()
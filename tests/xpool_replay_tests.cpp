@@ -0,0 +1,231 @@
+#include "xpool_tester.hpp"
+
+#include <cstdlib>
+#include <sstream>
+
+// Replays a recorded action log through xpool_tester. Each line is one action:
+//
+//   {"time":1602936000,"account":"eoscatspools","name":"claim","actor":"someuser1234","data":{...}}
+//
+// Actions with the same time share a block and a block is produced only when
+// the time moves forward. Mainnet contract names are mapped onto the test
+// accounts and actors that do not exist yet are created on first use; before
+// a transfer the sender is topped up from the token's issuer, so deposits by
+// those new actors go through. Set XPOOL_REPLAY_LOG to replay a file, e.g. a
+// day of mainnet traffic to profile.
+
+class xpool_replay_tester : public xpool_tester
+{
+public:
+  struct replay_stats
+  {
+    uint64_t actions = 0;
+    uint64_t failed = 0;
+    uint64_t blocks = 0;
+    fc::microseconds elapsed;
+    std::map<string, uint64_t> failures; // failed count by "account::action" as in the log
+    vector<string> errors;               // "line N account::action: message" per failure
+  };
+
+  std::map<name, name> renames{{N(eoscatspools), N(rabbitspoolx)},
+                               {N(eoscatstoken), N(rabbitstoken)},
+                               {N(eoscatsadmin), N(rabbitsadmin)},
+                               {N(eoscatsdever), N(rabbitsadmin)}};
+
+  name rename(name n) const
+  {
+    auto itr = renames.find(n);
+    return itr == renames.end() ? n : itr->second;
+  }
+
+  fc::variant rename(const fc::variant &v) const
+  {
+    if (v.is_string())
+    {
+      for (const auto &r : renames)
+      {
+        if (v.get_string() == r.first.to_string())
+          return fc::variant(r.second.to_string());
+      }
+      return v;
+    }
+    if (v.is_object())
+    {
+      mvo out;
+      for (const auto &e : v.get_object())
+        out(e.key(), rename(e.value()));
+      return fc::variant(out);
+    }
+    if (v.is_array())
+    {
+      fc::variants out;
+      for (const auto &e : v.get_array())
+        out.push_back(rename(e));
+      return fc::variant(out);
+    }
+    return v;
+  }
+
+  abi_serializer &serializer_for(name account)
+  {
+    if (account == N(rabbitspoolx))
+      return abi_xpool_ser;
+    if (account == config::system_account_name)
+      return abi_system_ser;
+    return abi_token_ser;
+  }
+
+  void ensure_account(name a)
+  {
+    if (control->db().find<account_object, by_name>(a) == nullptr)
+    {
+      create_account_with_resources(a, config::system_account_name, core_sym::from_string("10.0000"), false);
+    }
+  }
+
+  // tops up `owner` from the token's issuer so a recorded transfer does not
+  // fail only because the replay account started out empty
+  void fund(name token, name owner, const asset &quantity)
+  {
+    const auto balance = get_token_balance(token, owner, quantity.get_symbol());
+    if (balance.get_amount() >= quantity.get_amount())
+      return;
+    const auto code = name(quantity.get_symbol().to_symbol_code().value);
+    const auto data = get_row_by_account(token, code, N(stat), code);
+    if (data.empty())
+      return;
+    const auto issuer = abi_token_ser.binary_to_variant("currency_stats", data, abi_serializer::create_yield_function(abi_serializer_max_time))["issuer"].as<name>();
+    if (issuer != owner)
+      transfer_token(token, issuer, owner, quantity - balance, "replay funding");
+  }
+
+  // advance the pending block to `time`, producing blocks only when it moves forward
+  void advance_to(uint32_t time, replay_stats &stats)
+  {
+    const auto pending_time = control->pending_block_time().sec_since_epoch();
+    BOOST_REQUIRE_MESSAGE(time >= pending_time, "replay log goes back in time at " << time);
+    if (time == pending_time)
+      return;
+
+    // seal the actions pushed so far at their own time, then skip ahead so
+    // the next pending block starts exactly at `time`
+    produce_block();
+    stats.blocks++;
+    const auto head_time = control->head_block_time();
+    const auto target = fc::time_point(fc::seconds(time)) - fc::milliseconds(config::block_interval_ms);
+    if (target > head_time)
+    {
+      produce_block(target - head_time);
+      stats.blocks++;
+    }
+  }
+
+  replay_stats replay(std::istream &log, uint32_t base_time = 0)
+  {
+    replay_stats stats;
+    const auto start = fc::time_point::now();
+    string line;
+    uint64_t line_number = 0;
+    while (std::getline(log, line))
+    {
+      line_number++;
+      if (line.find_first_not_of(" \t\r") == string::npos)
+        continue;
+      const auto entry = fc::json::from_string(line).get_object();
+      advance_to(base_time + entry["time"].as<uint32_t>(), stats);
+
+      const auto account = rename(name(entry["account"].as_string()));
+      const auto actor = rename(name(entry["actor"].as_string()));
+      ensure_account(actor);
+
+      action act;
+      act.account = account;
+      act.name = name(entry["name"].as_string());
+      act.authorization = vector<permission_level>{{actor, config::active_name}};
+      const auto type = serializer_for(account).get_action_type(act.name);
+      const auto data = rename(entry["data"]);
+      act.data = serializer_for(account).variant_to_binary(type, data, abi_serializer::create_yield_function(abi_serializer_max_time));
+
+      signed_transaction trx;
+      trx.actions.emplace_back(std::move(act));
+      set_transaction_headers(trx);
+      trx.sign(get_private_key(actor, "active"), control->get_chain_id());
+      try
+      {
+        if (act.name == N(transfer) && account != N(rabbitspoolx) && data["from"].as<name>() == actor)
+          fund(account, actor, data["quantity"].as<asset>());
+        push_transaction(trx);
+      }
+      catch (const fc::exception &e)
+      {
+        // recorded traffic includes actions that failed on chain too
+        const auto action = entry["account"].as_string() + "::" + entry["name"].as_string();
+        stats.failed++;
+        stats.failures[action]++;
+        stats.errors.push_back("line " + std::to_string(line_number) + " " + action + ": " + e.top_message());
+        BOOST_TEST_MESSAGE(stats.errors.back());
+      }
+      stats.actions++;
+    }
+    produce_block();
+    stats.blocks++;
+    stats.elapsed = fc::time_point::now() - start;
+    return stats;
+  }
+};
+
+BOOST_AUTO_TEST_SUITE(xpool_replay_tests)
+
+BOOST_FIXTURE_TEST_CASE(replay_recorded_log, xpool_replay_tester)
+try
+{
+  // times are offsets from the start of the replay; names as on mainnet
+  const uint32_t base_time = control->pending_block_time().sec_since_epoch() + 10;
+  std::stringstream log;
+  log << R"({"time":0,"account":"eoscatspools","name":"create","actor":"eoscatsadmin","data":{"contract":"eosio.token","sym":"4,EOS","reward":"13000.0000 CAT","epoch_time":)" << base_time << R"(,"duration":604800,"min_staked":"1.0000 EOS","type":0,"schedule":[]}})" << "\n"
+      << R"({"time":0,"account":"eosio.token","name":"transfer","actor":"eosio","data":{"from":"eosio","to":"replayuser11","quantity":"100.0000 EOS","memo":""}})" << "\n"
+      << R"({"time":0,"account":"eosio.token","name":"transfer","actor":"replayuser11","data":{"from":"replayuser11","to":"eoscatspools","quantity":"10.0000 EOS","memo":""}})" << "\n"
+      << R"({"time":60,"account":"eosio.token","name":"transfer","actor":"rabbitsuser1","data":{"from":"rabbitsuser1","to":"eoscatspools","quantity":"10.0000 EOS","memo":""}})" << "\n"
+      << R"({"time":60,"account":"eosio.token","name":"transfer","actor":"replayuser12","data":{"from":"replayuser12","to":"eoscatspools","quantity":"10.0000 EOS","memo":""}})" << "\n"
+      << R"({"time":60,"account":"eoscatspools","name":"claim","actor":"rabbitsuser2","data":{"owner":"rabbitsuser2","pool_id":1}})" << "\n"
+      << R"({"time":120,"account":"eoscatspools","name":"harvestall","actor":"eoscatsadmin","data":{"nonce":1}})" << "\n"
+      << R"({"time":120,"account":"eoscatspools","name":"claim","actor":"replayuser11","data":{"owner":"replayuser11","pool_id":1}})" << "\n";
+
+  const auto stats = xpool_replay_tester::replay(log, base_time);
+  BOOST_REQUIRE_EQUAL(stats.actions, 8);
+  // rabbitsuser2 has no stake to claim
+  BOOST_REQUIRE_EQUAL(stats.failed, 1);
+  BOOST_REQUIRE_EQUAL(stats.failures.size(), 1);
+  BOOST_REQUIRE_EQUAL(stats.failures.at("eoscatspools::claim"), 1);
+  BOOST_REQUIRE_EQUAL(stats.errors.size(), 1);
+  BOOST_REQUIRE_EQUAL(stats.errors[0].find("line 6 eoscatspools::claim: "), 0);
+  // two blocks per time step (seal, then skip ahead), plus the last one
+  BOOST_REQUIRE_EQUAL(stats.blocks, 7);
+
+  auto miner = get_xpool_miner(N(replayuser11), 1);
+  BOOST_REQUIRE_EQUAL(miner["staked"], "9.0000 EOS");
+  // replayuser12 was created by the replay and funded for its deposit
+  BOOST_REQUIRE_EQUAL(get_xpool_miner(N(replayuser12), 1)["staked"], "9.0000 EOS");
+  BOOST_REQUIRE(miner["claimed"].as<asset>().get_amount() > 0);
+  BOOST_REQUIRE_EQUAL(get_xpool_pool(1)["last_harvest_time"], base_time + 120);
+}
+FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE(replay_log_file, xpool_replay_tester)
+try
+{
+  const char *path = std::getenv("XPOOL_REPLAY_LOG");
+  if (path == nullptr)
+    return;
+
+  std::ifstream log(path);
+  BOOST_REQUIRE_MESSAGE(log.good(), "cannot open " << path);
+  const auto stats = xpool_replay_tester::replay(log);
+  BOOST_TEST_MESSAGE("replayed " << stats.actions << " actions (" << stats.failed << " failed) in "
+                                 << stats.blocks << " blocks, " << stats.elapsed.count() / 1000 << " ms");
+  for (const auto &f : stats.failures)
+    BOOST_TEST_MESSAGE("  " << f.first << ": " << f.second << " failed");
+}
+FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,618 @@
+#pragma once
+#include <eosio/testing/tester.hpp>
+#include <eosio/chain/abi_serializer.hpp>
+#include <eosio/chain/resource_limits.hpp>
+#include <eosio/chain/genesis_state.hpp>
+#include <fc/filesystem.hpp>
+#include "contracts.hpp"
+#include "test_symbol.hpp"
+
+#include <core.hpp>
+
+#include <fc/io/json.hpp>
+#include <fc/variant_object.hpp>
+#include <cstring>
+#include <fstream>
+
+using namespace eosio;
+using namespace eosio::chain;
+using namespace eosio::testing;
+using namespace fc;
+using namespace std;
+
+using mvo = fc::mutable_variant_object;
+using eosio::chain::uint128_t;
+
+class xpool_tester : public tester
+{
+public:
+  void basic_setup()
+  {
+    produce_blocks(2);
+
+    create_accounts({N(eosio.token), N(eosio.ram), N(eosio.ramfee), N(eosio.stake),
+                     N(eosio.bpay), N(eosio.vpay), N(eosio.saving), N(eosio.names), N(eosio.rex)});
+
+    produce_blocks(100);
+    deploy_token(N(eosio.token));
+  }
+
+  void deploy_token(const name token)
+  {
+    set_code(token, contracts::token_wasm());
+    set_abi(token, contracts::token_abi().data());
+    {
+      const auto &accnt = control->db().get<account_object, by_name>(token);
+      abi_def abi;
+      BOOST_REQUIRE_EQUAL(abi_serializer::to_abi(accnt.abi, abi), true);
+      abi_token_ser.set_abi(abi, abi_serializer::create_yield_function(abi_serializer_max_time));
+    }
+  }
+
+  void create_currency(name contract, name manager, asset maxsupply)
+  {
+    auto act = mvo()("issuer", manager)("maximum_supply", maxsupply);
+    base_tester::push_action(contract, N(create), contract, act);
+  }
+
+  void issue(const name contract, const asset &amount, const name &manager, const name &to)
+  {
+    base_tester::push_action(contract, N(issue), manager, mvo()("to", to)("quantity", amount)("memo", ""));
+  }
+
+  void create_core_token(symbol core_symbol = symbol{CORE_SYM})
+  {
+    FC_ASSERT(core_symbol.decimals() == 4, "create_core_token assumes core token has 4 digits of precision");
+    create_currency(N(eosio.token), config::system_account_name, asset(100000000000000, core_symbol));
+    issue(N(eosio.token), asset(10000000000000, core_symbol), N(eosio), N(eosio));
+    BOOST_REQUIRE_EQUAL(asset(10000000000000, core_symbol), get_token_balance(N(eosio.token), "eosio", core_symbol));
+  }
+
+  void create_token(name contract, name manager, uint64_t maxsupply, symbol sym)
+  {
+    create_currency(contract, manager, asset(maxsupply, sym));
+    issue(contract, asset(maxsupply, sym), manager, manager);
+    BOOST_REQUIRE_EQUAL(asset(maxsupply, sym), get_token_balance(contract, manager.to_string(), sym));
+  }
+
+  void transfer_token(const name &code, const name &from, const name &to, const asset &amount, const string &memo)
+  {
+    base_tester::push_action(code, N(transfer), from, mvo()("from", from)("to", to)("quantity", amount)("memo", memo));
+  }
+
+  action_result push_token_action(const account_name &code, const account_name &signer, const action_name &name, const variant_object &data)
+  {
+    string action_type_name = abi_token_ser.get_action_type(name);
+
+    action act;
+    act.account = code;
+    act.name = name;
+    act.data = abi_token_ser.variant_to_binary(action_type_name, data, abi_serializer::create_yield_function(abi_serializer_max_time));
+
+    return base_tester::push_action(std::move(act), signer.to_uint64_t());
+  }
+
+  action_result tf_token(name code, account_name from, account_name to, asset quantity, string memo)
+  {
+    return push_token_action(code, from, N(transfer), mvo()("from", from)("to", to)("quantity", quantity)("memo", memo));
+  }
+
+  void deploy_system_contract(bool call_init = true)
+  {
+    set_code(config::system_account_name, contracts::system_wasm());
+    set_abi(config::system_account_name, contracts::system_abi().data());
+    if (call_init)
+    {
+      base_tester::push_action(config::system_account_name, N(init),
+                               config::system_account_name, mutable_variant_object()("version", 0)("core", CORE_SYM_STR));
+    }
+    {
+      const auto &accnt = control->db().get<account_object, by_name>(config::system_account_name);
+      abi_def abi;
+      BOOST_REQUIRE_EQUAL(abi_serializer::to_abi(accnt.abi, abi), true);
+      abi_system_ser.set_abi(abi, abi_serializer::create_yield_function(abi_serializer_max_time));
+    }
+  }
+
+  void init_accounts()
+  {
+    create_account_with_resources(N(rabbitstoken), config::system_account_name, core_sym::from_string("100.0000"), false);
+    create_account_with_resources(N(rabbitspoolx), config::system_account_name, core_sym::from_string("100.0000"), false);
+    create_account_with_resources(N(rabbitsadmin), config::system_account_name, core_sym::from_string("100.0000"), false);
+
+    create_account_with_resources(N(tethertether), config::system_account_name, core_sym::from_string("100.0000"), false);
+    create_account_with_resources(N(eosdmdtokens), config::system_account_name, core_sym::from_string("100.0000"), false);
+    create_account_with_resources(N(tokenaceosdt), config::system_account_name, core_sym::from_string("100.0000"), false);
+    create_account_with_resources(N(tokenaceusde), config::system_account_name, core_sym::from_string("100.0000"), false);
+    create_account_with_resources(N(tokenacctaaa), config::system_account_name, core_sym::from_string("100.0000"), false);
+
+    create_account_with_resources(N(rabbitsuser1), config::system_account_name, core_sym::from_string("100.0000"), false);
+    create_account_with_resources(N(rabbitsuser2), config::system_account_name, core_sym::from_string("100.0000"), false);
+    create_account_with_resources(N(rabbitsuser3), config::system_account_name, core_sym::from_string("100.0000"), false);
+
+    set_authority(N(rabbitspoolx), config::active_name,
+                  authority(1, {{get_public_key(N(rabbitspoolx), "active"), 1}},
+                            {{{N(rabbitspoolx), config::eosio_code_name}, 1}}),
+                  config::owner_name,
+                  {{N(rabbitspoolx), config::active_name}},
+                  {get_private_key(N(rabbitspoolx), "active")});
+  }
+
+  void deploy_xpool()
+  {
+    set_code(N(rabbitspoolx), contracts::xpool_wasm());
+    set_abi(N(rabbitspoolx), contracts::xpool_abi().data());
+    {
+      const auto &accnt = control->db().get<account_object, by_name>(N(rabbitspoolx));
+      abi_def abi;
+      BOOST_REQUIRE_EQUAL(abi_serializer::to_abi(accnt.abi, abi), true);
+      abi_xpool_ser.set_abi(abi, abi_serializer::create_yield_function(abi_serializer_max_time));
+    }
+  }
+
+  void setup_token_RAB()
+  {
+    const symbol sym = symbol(SY(4, CAT));
+    set_code(N(rabbitstoken), contracts::token_wasm());
+    set_abi(N(rabbitstoken), contracts::token_abi().data());
+    {
+      const auto &accnt = control->db().get<account_object, by_name>(N(rabbitstoken));
+      abi_def abi;
+      BOOST_REQUIRE_EQUAL(abi_serializer::to_abi(accnt.abi, abi), true);
+      abi_token_ser.set_abi(abi, abi_serializer::create_yield_function(abi_serializer_max_time));
+    }
+
+    create_currency(N(rabbitstoken), N(rabbitspoolx), asset(2'1000'0000, sym));
+  }
+
+  void setup_token_EOS()
+  {
+    const symbol sym = symbol{CORE_SYM};
+    const asset amt = asset(10000'0000, sym);
+    transfer_token(N(eosio.token), N(eosio), N(rabbitsuser1), amt, "");
+    transfer_token(N(eosio.token), N(eosio), N(rabbitsuser2), amt, "");
+    transfer_token(N(eosio.token), N(eosio), N(rabbitsuser3), amt, "");
+    BOOST_REQUIRE_EQUAL(amt, get_token_balance(N(eosio.token), "rabbitsuser1", sym));
+    BOOST_REQUIRE_EQUAL(amt, get_token_balance(N(eosio.token), "rabbitsuser2", sym));
+    BOOST_REQUIRE_EQUAL(amt, get_token_balance(N(eosio.token), "rabbitsuser3", sym));
+  }
+
+  void setup_token_USDT()
+  {
+    const symbol sym = symbol(SY(4, USDT));
+    deploy_token(N(tethertether));
+    create_token(N(tethertether), N(tethertether), 10000'0000'0000, sym);
+
+    const asset amt = asset(10000'0000, sym);
+    transfer_token(N(tethertether), N(tethertether), N(rabbitsuser1), amt, "");
+    transfer_token(N(tethertether), N(tethertether), N(rabbitsuser2), amt, "");
+    BOOST_REQUIRE_EQUAL(amt, get_token_balance(N(tethertether), "rabbitsuser1", sym));
+    BOOST_REQUIRE_EQUAL(amt, get_token_balance(N(tethertether), "rabbitsuser2", sym));
+
+    // Fake Token
+    const symbol symX = symbol(SY(4, USDTT));
+    create_token(N(tethertether), N(tethertether), 10000'0000'0000, symX);
+
+    const asset amtX = asset(10000'0000, symX);
+    transfer_token(N(tethertether), N(tethertether), N(rabbitsuser1), amtX, "");
+    transfer_token(N(tethertether), N(tethertether), N(rabbitsuser2), amtX, "");
+    BOOST_REQUIRE_EQUAL(amtX, get_token_balance(N(tethertether), "rabbitsuser1", symX));
+    BOOST_REQUIRE_EQUAL(amtX, get_token_balance(N(tethertether), "rabbitsuser2", symX));
+  }
+
+  void setup_token_USDE()
+  {
+    const symbol sym = symbol(SY(4, USDE));
+    deploy_token(N(tokenaceusde));
+    create_token(N(tokenaceusde), N(tokenaceusde), 10000'0000'0000, sym);
+
+    const asset amt = asset(10000'0000, sym);
+    transfer_token(N(tokenaceusde), N(tokenaceusde), N(rabbitsuser1), amt, "");
+    transfer_token(N(tokenaceusde), N(tokenaceusde), N(rabbitsuser2), amt, "");
+    BOOST_REQUIRE_EQUAL(amt, get_token_balance(N(tokenaceusde), "rabbitsuser1", sym));
+    BOOST_REQUIRE_EQUAL(amt, get_token_balance(N(tokenaceusde), "rabbitsuser2", sym));
+  }
+
+  void setup_token_EOSDT()
+  {
+    const symbol sym = symbol(SY(4, EOSDT));
+    deploy_token(N(tokenaceosdt));
+    create_token(N(tokenaceosdt), N(tokenaceosdt), 10000'0000'0000, sym);
+
+    const asset amt = asset(10000'0000, sym);
+    transfer_token(N(tokenaceosdt), N(tokenaceosdt), N(rabbitsuser1), amt, "");
+    transfer_token(N(tokenaceosdt), N(tokenaceosdt), N(rabbitsuser2), amt, "");
+    BOOST_REQUIRE_EQUAL(amt, get_token_balance(N(tokenaceosdt), "rabbitsuser1", sym));
+    BOOST_REQUIRE_EQUAL(amt, get_token_balance(N(tokenaceosdt), "rabbitsuser2", sym));
+  }
+
+  void setup_token_DMD()
+  {
+    const symbol sym = symbol(SY(10, DMD));
+    deploy_token(N(eosdmdtokens));
+    create_token(N(eosdmdtokens), N(eosdmdtokens), 10000'00'0000'0000, sym);
+
+    const asset amt = asset(1000'00'0000'0000, sym);
+    transfer_token(N(eosdmdtokens), N(eosdmdtokens), N(rabbitsuser1), amt, "");
+    transfer_token(N(eosdmdtokens), N(eosdmdtokens), N(rabbitsuser2), amt, "");
+    BOOST_REQUIRE_EQUAL(amt, get_token_balance(N(eosdmdtokens), "rabbitsuser1", sym));
+    BOOST_REQUIRE_EQUAL(amt, get_token_balance(N(eosdmdtokens), "rabbitsuser2", sym));
+  }
+
+  void setup_token_AAA()
+  {
+    const symbol sym = symbol(SY(4, AAA));
+    deploy_token(N(tokenacctaaa));
+    create_token(N(tokenacctaaa), N(tokenacctaaa), 10'0000'0000, sym);
+
+    const asset amt = asset(1'0000'0000, sym);
+    transfer_token(N(tokenacctaaa), N(tokenacctaaa), N(rabbitsuser1), amt, "");
+    transfer_token(N(tokenacctaaa), N(tokenacctaaa), N(rabbitsuser2), amt, "");
+    BOOST_REQUIRE_EQUAL(amt, get_token_balance(N(tokenacctaaa), "rabbitsuser1", sym));
+    BOOST_REQUIRE_EQUAL(amt, get_token_balance(N(tokenacctaaa), "rabbitsuser2", sym));
+  }
+
+  xpool_tester()
+  {
+    basic_setup();
+    create_core_token();
+    deploy_system_contract();
+    init_accounts();
+
+    setup_token_EOS();
+    setup_token_USDT();
+    setup_token_USDE();
+    setup_token_EOSDT();
+    setup_token_DMD();
+    setup_token_RAB();
+    deploy_xpool();
+    setup_token_AAA();
+  }
+
+  transaction_trace_ptr create_account_with_resources(account_name a, account_name creator, asset ramfunds, bool multisig,
+                                                      asset net = core_sym::from_string("10.0000"), asset cpu = core_sym::from_string("10.0000"))
+  {
+    signed_transaction trx;
+    set_transaction_headers(trx);
+
+    authority owner_auth;
+    if (multisig)
+    {
+      // multisig between account's owner key and creators active permission
+      owner_auth = authority(2, {key_weight{get_public_key(a, "owner"), 1}}, {permission_level_weight{{creator, config::active_name}, 1}});
+    }
+    else
+    {
+      owner_auth = authority(get_public_key(a, "owner"));
+    }
+
+    trx.actions.emplace_back(vector<permission_level>{{creator, config::active_name}},
+                             newaccount{
+                                 .creator = creator,
+                                 .name = a,
+                                 .owner = owner_auth,
+                                 .active = authority(get_public_key(a, "active"))});
+
+    trx.actions.emplace_back(get_action(config::system_account_name, N(buyram), vector<permission_level>{{creator, config::active_name}},
+                                        mvo()("payer", creator)("receiver", a)("quant", ramfunds)));
+
+    trx.actions.emplace_back(get_action(config::system_account_name, N(delegatebw), vector<permission_level>{{creator, config::active_name}},
+                                        mvo()("from", creator)("receiver", a)("stake_net_quantity", net)("stake_cpu_quantity", cpu)("transfer", 0)));
+
+    set_transaction_headers(trx);
+    trx.sign(get_private_key(creator, "active"), control->get_chain_id());
+    return push_transaction(trx);
+  }
+
+  vector<char> get_row_by_primary_key(name code, name scope, name table, const uint64_t key) const
+  {
+    vector<char> data;
+    const auto &db = control->db();
+    const auto *t_id = db.find<chain::table_id_object, chain::by_code_scope_table>(boost::make_tuple(code, scope, table));
+    if (!t_id)
+    {
+      return data;
+    }
+    FC_ASSERT(t_id != 0, "object not found");
+    const auto &idx = db.get_index<chain::key_value_index, chain::by_scope_primary>();
+
+    auto itr = idx.lower_bound(boost::make_tuple(t_id->id, key));
+    if (itr == idx.end() || itr->t_id != t_id->id || key != itr->primary_key)
+    {
+      return data;
+    }
+
+    data.resize(itr->value.size());
+    memcpy(data.data(), itr->value.data(), data.size());
+    return data;
+  }
+
+  // writes raw row bytes, for rows in a layout the current ABI no longer describes
+  void set_row(name code, name scope, name table, const uint64_t key, const vector<char> &data)
+  {
+    auto &db = control->mutable_db();
+    const auto *t_id = db.find<chain::table_id_object, chain::by_code_scope_table>(boost::make_tuple(code, scope, table));
+    if (!t_id)
+    {
+      t_id = &db.create<chain::table_id_object>([&](auto &t) {
+        t.code = code;
+        t.scope = scope;
+        t.table = table;
+        t.payer = code;
+      });
+    }
+    db.create<chain::key_value_object>([&](auto &o) {
+      o.t_id = t_id->id;
+      o.primary_key = key;
+      o.payer = code;
+      o.value.assign(data.data(), data.size());
+    });
+    db.modify(*t_id, [](auto &t) { t.count++; });
+  }
+
+  // fields packed back to back, the way multi_index serializes a row
+  template <typename... T>
+  static vector<char> pack_row(const T &...fields)
+  {
+    vector<char> data;
+    auto append = [&](const auto &field) {
+      const auto bytes = fc::raw::pack(field);
+      data.insert(data.end(), bytes.begin(), bytes.end());
+    };
+    (append(fields), ...);
+    return data;
+  }
+
+  asset get_token_balance(const name code, const account_name &act, symbol balance_symbol = symbol{CORE_SYM})
+  {
+    vector<char> data = get_row_by_account(code, act, N(accounts), account_name(balance_symbol.to_symbol_code().value));
+    return data.empty() ? asset(0, balance_symbol) : abi_token_ser.binary_to_variant("account", data, abi_serializer::create_yield_function(abi_serializer_max_time))["balance"].as<asset>();
+  }
+
+  asset get_token_balance(const name code, std::string_view act, symbol balance_symbol = symbol{CORE_SYM})
+  {
+    return get_token_balance(code, account_name(act), balance_symbol);
+  }
+
+  action_result push_xpool_action(const account_name &signer, const action_name &name, const variant_object &data)
+  {
+    string action_type_name = abi_xpool_ser.get_action_type(name);
+
+    action act;
+    act.account = N(rabbitspoolx);
+    act.name = name;
+    act.data = abi_xpool_ser.variant_to_binary(action_type_name, data, abi_serializer::create_yield_function(abi_serializer_max_time));
+
+    return base_tester::push_action(std::move(act), signer.to_uint64_t());
+  }
+
+  fc::variant get_xpool_pool(const uint64_t pool_id)
+  {
+    vector<char> data = get_row_by_primary_key(N(rabbitspoolx), N(rabbitspoolx), N(pools), pool_id);
+    if (data.empty())
+    {
+      std::cout << "\nData is empty\n"
+                << std::endl;
+      return fc::variant();
+    }
+    auto pool = abi_xpool_ser.binary_to_variant("pool", data, abi_serializer::create_yield_function(abi_serializer_max_time));
+
+    // overlay the live counters, the same way xpool::read_stats does
+    data = get_row_by_primary_key(N(rabbitspoolx), N(rabbitspoolx), N(poolstats), pool_id);
+    if (data.empty())
+      return pool;
+    auto stats = abi_xpool_ser.binary_to_variant("poolstat", data, abi_serializer::create_yield_function(abi_serializer_max_time));
+    return mvo(pool.get_object())
+        ("total_staked", asset(stats["total_staked"].as_int64(), pool["sym"].as<symbol>()))
+        ("released_reward", asset(stats["released_reward"].as_int64(), symbol(SY(4, CAT))))
+        ("last_harvest_time", stats["last_harvest_time"])
+        ("acc_reward_per_share", stats["acc_reward_per_share"])
+        ("reward_dust", stats["reward_dust"])
+        ("distributed", asset(stats["distributed"].as_int64(), symbol(SY(4, CAT))));
+  }
+
+  fc::variant get_xpool_global()
+  {
+    vector<char> data = get_row_by_primary_key(N(rabbitspoolx), N(rabbitspoolx), N(global), N(global).to_uint64_t());
+    return data.empty() ? fc::variant() : abi_xpool_ser.binary_to_variant("global", data, abi_serializer::create_yield_function(abi_serializer_max_time));
+  }
+
+  asset get_xpool_fee(const name contract, const symbol sym)
+  {
+    vector<char> data = get_row_by_primary_key(N(rabbitspoolx), contract, N(fees), sym.to_symbol_code().value);
+    return data.empty() ? asset(0, sym) : abi_xpool_ser.binary_to_variant("fee", data, abi_serializer::create_yield_function(abi_serializer_max_time))["balance"].as<asset>();
+  }
+
+  vector<uint64_t> get_xpool_positions(const name owner)
+  {
+    vector<char> data = get_row_by_primary_key(N(rabbitspoolx), N(rabbitspoolx), N(positions), owner.to_uint64_t());
+    return data.empty() ? vector<uint64_t>() : abi_xpool_ser.binary_to_variant("position", data, abi_serializer::create_yield_function(abi_serializer_max_time))["pool_ids"].as<vector<uint64_t>>();
+  }
+
+  fc::variant get_xpool_token(const name contract)
+  {
+    vector<char> data = get_row_by_primary_key(N(rabbitspoolx), N(rabbitspoolx), N(tokens), contract.to_uint64_t());
+    return data.empty() ? fc::variant() : abi_xpool_ser.binary_to_variant("token", data, abi_serializer::create_yield_function(abi_serializer_max_time));
+  }
+
+  fc::variant get_xpool_miner(const name owner, const uint64_t pool_id)
+  {
+    vector<char> data = get_row_by_account(N(rabbitspoolx), name(pool_id), N(minersv1), owner);
+    if (data.empty())
+    {
+      std::cout << "\nData is empty\n"
+                << std::endl;
+      return fc::variant();
+    }
+
+    // expand the compact row back to assets, the same way xpool::get_miner does
+    auto miner = abi_xpool_ser.binary_to_variant("miner", data, abi_serializer::create_yield_function(abi_serializer_max_time));
+    const auto sym = get_xpool_pool(pool_id)["sym"].as<symbol>();
+    const auto cat = symbol(SY(4, CAT));
+    return mvo()("owner", miner["owner"])
+                ("staked", asset(miner["staked"].as_int64(), sym))
+                ("claimed", asset(miner["claimed"].as_int64(), cat))
+                ("unclaimed", asset(miner["unclaimed"].as_int64(), cat))
+                ("reward_debt", miner["reward_debt"]);
+  }
+
+  // the pool's emission schedule, one flat segment when it was created without one
+  vector<core::segment> get_xpool_schedule(const fc::variant &pool)
+  {
+    vector<core::segment> schedule;
+    if (pool.get_object().contains("schedule"))
+    {
+      for (const auto &s : pool["schedule"].get_array())
+        schedule.push_back({s["start_time"].as<uint32_t>(), s["end_time"].as<uint32_t>(), s["amount"].as<uint64_t>()});
+    }
+    if (schedule.empty())
+    {
+      const auto epoch_time = pool["epoch_time"].as<uint32_t>();
+      schedule.push_back({epoch_time, epoch_time + pool["duration"].as<uint32_t>(), uint64_t(pool["total_reward"].as<asset>().get_amount())});
+    }
+    return schedule;
+  }
+
+  asset get_xpool_pending(const name owner, const uint64_t pool_id)
+  {
+    auto pool = get_xpool_pool(pool_id);
+    auto miner = get_xpool_miner(owner, pool_id);
+
+    // accrue up to the pending block the way xpool::accrue does before a claim;
+    // pools paying through merkle roots stay where setroot left them
+    auto counters = core::pool_counters{uint64_t(pool["total_staked"].as<asset>().get_amount()),
+                                        uint64_t(pool["released_reward"].as<asset>().get_amount()),
+                                        pool["last_harvest_time"].as<uint32_t>(),
+                                        {pool["acc_reward_per_share"].as<uint128_t>(), pool["reward_dust"].as<uint64_t>()}};
+    if (!pool.get_object().contains("distributed") || pool["distributed"].as<asset>().get_amount() == 0)
+    {
+      const auto schedule = get_xpool_schedule(pool);
+      const auto end_time = pool["epoch_time"].as<uint32_t>() + pool["duration"].as<uint32_t>();
+      core::accrue_pool(counters, end_time, control->pending_block_time().sec_since_epoch(),
+                        [&](const uint32_t time) { return core::emitted(schedule, time); });
+    }
+    const auto pending = core::pending_reward(counters.acc.acc_reward_per_share, miner["staked"].as<asset>().get_amount(),
+                                              miner["reward_debt"].as<uint128_t>(), std::numeric_limits<int64_t>::max());
+    return miner["unclaimed"].as<asset>() + asset(int64_t(pending), symbol(SY(4, CAT)));
+  }
+
+  // payloads of the `log` actions the contract sent inline in a transaction
+  vector<fc::variant> xpool_logs(const transaction_trace_ptr &trace, const action_name &log)
+  {
+    vector<fc::variant> logs;
+    for (const auto &at : trace->action_traces)
+    {
+      if (at.receiver == N(rabbitspoolx) && at.act.account == N(rabbitspoolx) && at.act.name == log)
+      {
+        logs.push_back(abi_xpool_ser.binary_to_variant(abi_xpool_ser.get_action_type(log), at.act.data, abi_serializer::create_yield_function(abi_serializer_max_time)));
+      }
+    }
+    return logs;
+  }
+
+  action_result xpool_create(name contract, symbol sym, asset reward, uint32_t epoch_time, uint32_t duration, asset min_staked, uint8_t type,
+                             const fc::variants &schedule = {})
+  {
+    auto data = mvo()("contract", contract)("sym", sym)("reward", reward)("epoch_time", epoch_time)("duration", duration)("min_staked", min_staked)("type", type);
+    // schedule is a binary extension, callers written before it leave it out
+    if (!schedule.empty())
+      data("schedule", schedule);
+    return push_xpool_action(N(rabbitsadmin), N(create), data);
+  }
+
+  static fc::variant xpool_segment(uint32_t start_time, uint32_t end_time, uint64_t amount)
+  {
+    return mvo()("start_time", start_time)("end_time", end_time)("amount", amount);
+  }
+
+  // leaf and parent hashes of a merkle distribution, as core::leaf_message and core::hash_pair build them
+  static fc::sha256 xpool_leaf(name owner, uint64_t pool_id, uint64_t epoch, int64_t amount)
+  {
+    const uint64_t words[4] = {owner.to_uint64_t(), pool_id, epoch, uint64_t(amount)};
+    char msg[32];
+    for (int w = 0; w < 4; w++)
+    {
+      for (int b = 0; b < 8; b++)
+        msg[w * 8 + b] = char(words[w] >> (8 * b));
+    }
+    return fc::sha256::hash(msg, sizeof(msg));
+  }
+
+  static fc::sha256 xpool_hash_pair(const fc::sha256 &a, const fc::sha256 &b)
+  {
+    const bool a_first = std::memcmp(a.data(), b.data(), 32) < 0;
+    char msg[64];
+    std::memcpy(msg, (a_first ? a : b).data(), 32);
+    std::memcpy(msg + 32, (a_first ? b : a).data(), 32);
+    return fc::sha256::hash(msg, sizeof(msg));
+  }
+
+  action_result xpool_setroot(uint64_t pool_id, uint64_t epoch, const fc::sha256 &root, asset total)
+  {
+    return push_xpool_action(N(rabbitsadmin), N(setroot), mvo()("pool_id", pool_id)("epoch", epoch)("root", root)("total", total));
+  }
+
+  action_result xpool_claimproof(name owner, uint64_t pool_id, uint64_t epoch, asset amount, const vector<fc::sha256> &proof)
+  {
+    return push_xpool_action(owner, N(claimproof), mvo()("owner", owner)("pool_id", pool_id)("epoch", epoch)("amount", amount)("proof", proof));
+  }
+
+  action_result xpool_claim(name owner, uint64_t pool_id)
+  {
+    return push_xpool_action(owner, N(claim), mvo()("owner", owner)("pool_id", pool_id));
+  }
+
+  action_result xpool_claimall(name owner)
+  {
+    return push_xpool_action(owner, N(claimall), mvo()("owner", owner));
+  }
+
+  action_result xpool_getpending(name owner, const vector<uint64_t> &pool_ids)
+  {
+    return push_xpool_action(N(rabbitsuser3), N(getpending), mvo()("owner", owner)("pool_ids", pool_ids));
+  }
+
+  action_result xpool_sweepfees(name contract, symbol sym)
+  {
+    return push_xpool_action(N(rabbitsuser3), N(sweepfees), mvo()("contract", contract)("sym", sym));
+  }
+
+  action_result xpool_flushram(uint32_t limit)
+  {
+    return push_xpool_action(N(rabbitsuser3), N(flushram), mvo()("limit", limit));
+  }
+
+  action_result xpool_harvest(uint64_t pool_id, uint32_t nonce)
+  {
+    return push_xpool_action(N(rabbitsadmin), N(harvest), mvo()("pool_id", pool_id)("nonce", nonce));
+  }
+
+  action_result xpool_harvestall(uint32_t nonce)
+  {
+    return push_xpool_action(N(rabbitsadmin), N(harvestall), mvo()("nonce", nonce));
+  }
+
+  // every row of a contract as JSON lines, the input of tools/xpool-snapshot
+  void dump_tables(const name code, const abi_serializer &ser, std::ostream &out)
+  {
+    const auto &db = control->db();
+    const auto &tables = db.get_index<table_id_multi_index, by_code_scope_table>();
+    const auto &rows = db.get_index<key_value_index, by_scope_primary>();
+    for (auto t = tables.lower_bound(boost::make_tuple(code)); t != tables.end() && t->code == code; ++t)
+    {
+      const auto type = ser.get_table_type(t->table);
+      if (type.empty())
+        continue;
+      for (auto r = rows.lower_bound(boost::make_tuple(t->id)); r != rows.end() && r->t_id == t->id; ++r)
+      {
+        vector<char> data(r->value.data(), r->value.data() + r->value.size());
+        auto row = ser.binary_to_variant(type, data, abi_serializer::create_yield_function(abi_serializer_max_time));
+        out << fc::json::to_string(mvo()("code", code)("scope", t->scope.to_uint64_t())("table", t->table)("row", row), fc::time_point::maximum()) << "\n";
+      }
+    }
+  }
+
+  abi_serializer abi_token_ser;
+  abi_serializer abi_xpool_ser;
+  abi_serializer abi_system_ser;
+};
@@ -1,387 +1,4 @@
-#include <eosio/testing/tester.hpp>
-#include <eosio/chain/abi_serializer.hpp>
-#include <eosio/chain/resource_limits.hpp>
-#include <eosio/chain/genesis_state.hpp>
-#include <fc/filesystem.hpp>
-#include "contracts.hpp"
-#include "test_symbol.hpp"
-
-#include <fc/variant_object.hpp>
-#include <fstream>
-
-using namespace eosio;
-using namespace eosio::chain;
-using namespace eosio::testing;
-using namespace fc;
-using namespace std;
-
-using mvo = fc::mutable_variant_object;
-using eosio::chain::uint128_t;
-
-class xpool_tester : public tester
-{
-public:
-  void basic_setup()
-  {
-    produce_blocks(2);
-
-    create_accounts({N(eosio.token), N(eosio.ram), N(eosio.ramfee), N(eosio.stake),
-                     N(eosio.bpay), N(eosio.vpay), N(eosio.saving), N(eosio.names), N(eosio.rex)});
-
-    produce_blocks(100);
-    deploy_token(N(eosio.token));
-  }
-
-  void deploy_token(const name token)
-  {
-    set_code(token, contracts::token_wasm());
-    set_abi(token, contracts::token_abi().data());
-    {
-      const auto &accnt = control->db().get<account_object, by_name>(token);
-      abi_def abi;
-      BOOST_REQUIRE_EQUAL(abi_serializer::to_abi(accnt.abi, abi), true);
-      abi_token_ser.set_abi(abi, abi_serializer::create_yield_function(abi_serializer_max_time));
-    }
-  }
-
-  void create_currency(name contract, name manager, asset maxsupply)
-  {
-    auto act = mvo()("issuer", manager)("maximum_supply", maxsupply);
-    base_tester::push_action(contract, N(create), contract, act);
-  }
-
-  void issue(const name contract, const asset &amount, const name &manager, const name &to)
-  {
-    base_tester::push_action(contract, N(issue), manager, mvo()("to", to)("quantity", amount)("memo", ""));
-  }
-
-  void create_core_token(symbol core_symbol = symbol{CORE_SYM})
-  {
-    FC_ASSERT(core_symbol.decimals() == 4, "create_core_token assumes core token has 4 digits of precision");
-    create_currency(N(eosio.token), config::system_account_name, asset(100000000000000, core_symbol));
-    issue(N(eosio.token), asset(10000000000000, core_symbol), N(eosio), N(eosio));
-    BOOST_REQUIRE_EQUAL(asset(10000000000000, core_symbol), get_token_balance(N(eosio.token), "eosio", core_symbol));
-  }
-
-  void create_token(name contract, name manager, uint64_t maxsupply, symbol sym)
-  {
-    create_currency(contract, manager, asset(maxsupply, sym));
-    issue(contract, asset(maxsupply, sym), manager, manager);
-    BOOST_REQUIRE_EQUAL(asset(maxsupply, sym), get_token_balance(contract, manager.to_string(), sym));
-  }
-
-  void transfer_token(const name &code, const name &from, const name &to, const asset &amount, const string &memo)
-  {
-    base_tester::push_action(code, N(transfer), from, mvo()("from", from)("to", to)("quantity", amount)("memo", memo));
-  }
-
-  action_result push_token_action(const account_name &code, const account_name &signer, const action_name &name, const variant_object &data)
-  {
-    string action_type_name = abi_token_ser.get_action_type(name);
-
-    action act;
-    act.account = code;
-    act.name = name;
-    act.data = abi_token_ser.variant_to_binary(action_type_name, data, abi_serializer::create_yield_function(abi_serializer_max_time));
-
-    return base_tester::push_action(std::move(act), signer.to_uint64_t());
-  }
-
-  action_result tf_token(name code, account_name from, account_name to, asset quantity, string memo)
-  {
-    return push_token_action(code, from, N(transfer), mvo()("from", from)("to", to)("quantity", quantity)("memo", memo));
-  }
-
-  void deploy_system_contract(bool call_init = true)
-  {
-    set_code(config::system_account_name, contracts::system_wasm());
-    set_abi(config::system_account_name, contracts::system_abi().data());
-    if (call_init)
-    {
-      base_tester::push_action(config::system_account_name, N(init),
-                               config::system_account_name, mutable_variant_object()("version", 0)("core", CORE_SYM_STR));
-    }
-    {
-      const auto &accnt = control->db().get<account_object, by_name>(config::system_account_name);
-      abi_def abi;
-      BOOST_REQUIRE_EQUAL(abi_serializer::to_abi(accnt.abi, abi), true);
-      abi_system_ser.set_abi(abi, abi_serializer::create_yield_function(abi_serializer_max_time));
-    }
-  }
-
-  void init_accounts()
-  {
-    create_account_with_resources(N(rabbitstoken), config::system_account_name, core_sym::from_string("100.0000"), false);
-    create_account_with_resources(N(rabbitspoolx), config::system_account_name, core_sym::from_string("100.0000"), false);
-    create_account_with_resources(N(rabbitsadmin), config::system_account_name, core_sym::from_string("100.0000"), false);
-
-    create_account_with_resources(N(tethertether), config::system_account_name, core_sym::from_string("100.0000"), false);
-    create_account_with_resources(N(eosdmdtokens), config::system_account_name, core_sym::from_string("100.0000"), false);
-    create_account_with_resources(N(tokenaceosdt), config::system_account_name, core_sym::from_string("100.0000"), false);
-    create_account_with_resources(N(tokenaceusde), config::system_account_name, core_sym::from_string("100.0000"), false);
-    create_account_with_resources(N(tokenacctaaa), config::system_account_name, core_sym::from_string("100.0000"), false);
-
-    create_account_with_resources(N(rabbitsuser1), config::system_account_name, core_sym::from_string("100.0000"), false);
-    create_account_with_resources(N(rabbitsuser2), config::system_account_name, core_sym::from_string("100.0000"), false);
-    create_account_with_resources(N(rabbitsuser3), config::system_account_name, core_sym::from_string("100.0000"), false);
-
-    set_authority(N(rabbitspoolx), config::active_name,
-                  authority(1, {{get_public_key(N(rabbitspoolx), "active"), 1}},
-                            {{{N(rabbitspoolx), config::eosio_code_name}, 1}}),
-                  config::owner_name,
-                  {{N(rabbitspoolx), config::active_name}},
-                  {get_private_key(N(rabbitspoolx), "active")});
-  }
-
-  void deploy_xpool()
-  {
-    set_code(N(rabbitspoolx), contracts::xpool_wasm());
-    set_abi(N(rabbitspoolx), contracts::xpool_abi().data());
-    {
-      const auto &accnt = control->db().get<account_object, by_name>(N(rabbitspoolx));
-      abi_def abi;
-      BOOST_REQUIRE_EQUAL(abi_serializer::to_abi(accnt.abi, abi), true);
-      abi_xpool_ser.set_abi(abi, abi_serializer::create_yield_function(abi_serializer_max_time));
-    }
-  }
-
-  void setup_token_RAB()
-  {
-    const symbol sym = symbol(SY(4, CAT));
-    set_code(N(rabbitstoken), contracts::token_wasm());
-    set_abi(N(rabbitstoken), contracts::token_abi().data());
-    {
-      const auto &accnt = control->db().get<account_object, by_name>(N(rabbitstoken));
-      abi_def abi;
-      BOOST_REQUIRE_EQUAL(abi_serializer::to_abi(accnt.abi, abi), true);
-      abi_token_ser.set_abi(abi, abi_serializer::create_yield_function(abi_serializer_max_time));
-    }
-
-    create_currency(N(rabbitstoken), N(rabbitspoolx), asset(2'1000'0000, sym));
-  }
-
-  void setup_token_EOS()
-  {
-    const symbol sym = symbol{CORE_SYM};
-    const asset amt = asset(10000'0000, sym);
-    transfer_token(N(eosio.token), N(eosio), N(rabbitsuser1), amt, "");
-    transfer_token(N(eosio.token), N(eosio), N(rabbitsuser2), amt, "");
-    transfer_token(N(eosio.token), N(eosio), N(rabbitsuser3), amt, "");
-    BOOST_REQUIRE_EQUAL(amt, get_token_balance(N(eosio.token), "rabbitsuser1", sym));
-    BOOST_REQUIRE_EQUAL(amt, get_token_balance(N(eosio.token), "rabbitsuser2", sym));
-    BOOST_REQUIRE_EQUAL(amt, get_token_balance(N(eosio.token), "rabbitsuser3", sym));
-  }
-
-  void setup_token_USDT()
-  {
-    const symbol sym = symbol(SY(4, USDT));
-    deploy_token(N(tethertether));
-    create_token(N(tethertether), N(tethertether), 10000'0000'0000, sym);
-
-    const asset amt = asset(10000'0000, sym);
-    transfer_token(N(tethertether), N(tethertether), N(rabbitsuser1), amt, "");
-    transfer_token(N(tethertether), N(tethertether), N(rabbitsuser2), amt, "");
-    BOOST_REQUIRE_EQUAL(amt, get_token_balance(N(tethertether), "rabbitsuser1", sym));
-    BOOST_REQUIRE_EQUAL(amt, get_token_balance(N(tethertether), "rabbitsuser2", sym));
-
-    // Fake Token
-    const symbol symX = symbol(SY(4, USDTT));
-    create_token(N(tethertether), N(tethertether), 10000'0000'0000, symX);
-
-    const asset amtX = asset(10000'0000, symX);
-    transfer_token(N(tethertether), N(tethertether), N(rabbitsuser1), amtX, "");
-    transfer_token(N(tethertether), N(tethertether), N(rabbitsuser2), amtX, "");
-    BOOST_REQUIRE_EQUAL(amtX, get_token_balance(N(tethertether), "rabbitsuser1", symX));
-    BOOST_REQUIRE_EQUAL(amtX, get_token_balance(N(tethertether), "rabbitsuser2", symX));
-  }
-
-  void setup_token_USDE()
-  {
-    const symbol sym = symbol(SY(4, USDE));
-    deploy_token(N(tokenaceusde));
-    create_token(N(tokenaceusde), N(tokenaceusde), 10000'0000'0000, sym);
-
-    const asset amt = asset(10000'0000, sym);
-    transfer_token(N(tokenaceusde), N(tokenaceusde), N(rabbitsuser1), amt, "");
-    transfer_token(N(tokenaceusde), N(tokenaceusde), N(rabbitsuser2), amt, "");
-    BOOST_REQUIRE_EQUAL(amt, get_token_balance(N(tokenaceusde), "rabbitsuser1", sym));
-    BOOST_REQUIRE_EQUAL(amt, get_token_balance(N(tokenaceusde), "rabbitsuser2", sym));
-  }
-
-  void setup_token_EOSDT()
-  {
-    const symbol sym = symbol(SY(4, EOSDT));
-    deploy_token(N(tokenaceosdt));
-    create_token(N(tokenaceosdt), N(tokenaceosdt), 10000'0000'0000, sym);
-
-    const asset amt = asset(10000'0000, sym);
-    transfer_token(N(tokenaceosdt), N(tokenaceosdt), N(rabbitsuser1), amt, "");
-    transfer_token(N(tokenaceosdt), N(tokenaceosdt), N(rabbitsuser2), amt, "");
-    BOOST_REQUIRE_EQUAL(amt, get_token_balance(N(tokenaceosdt), "rabbitsuser1", sym));
-    BOOST_REQUIRE_EQUAL(amt, get_token_balance(N(tokenaceosdt), "rabbitsuser2", sym));
-  }
-
-  void setup_token_DMD()
-  {
-    const symbol sym = symbol(SY(10, DMD));
-    deploy_token(N(eosdmdtokens));
-    create_token(N(eosdmdtokens), N(eosdmdtokens), 10000'00'0000'0000, sym);
-
-    const asset amt = asset(1000'00'0000'0000, sym);
-    transfer_token(N(eosdmdtokens), N(eosdmdtokens), N(rabbitsuser1), amt, "");
-    transfer_token(N(eosdmdtokens), N(eosdmdtokens), N(rabbitsuser2), amt, "");
-    BOOST_REQUIRE_EQUAL(amt, get_token_balance(N(eosdmdtokens), "rabbitsuser1", sym));
-    BOOST_REQUIRE_EQUAL(amt, get_token_balance(N(eosdmdtokens), "rabbitsuser2", sym));
-  }
-
-  void setup_token_AAA()
-  {
-    const symbol sym = symbol(SY(4, AAA));
-    deploy_token(N(tokenacctaaa));
-    create_token(N(tokenacctaaa), N(tokenacctaaa), 10'0000'0000, sym);
-
-    const asset amt = asset(1'0000'0000, sym);
-    transfer_token(N(tokenacctaaa), N(tokenacctaaa), N(rabbitsuser1), amt, "");
-    transfer_token(N(tokenacctaaa), N(tokenacctaaa), N(rabbitsuser2), amt, "");
-    BOOST_REQUIRE_EQUAL(amt, get_token_balance(N(tokenacctaaa), "rabbitsuser1", sym));
-    BOOST_REQUIRE_EQUAL(amt, get_token_balance(N(tokenacctaaa), "rabbitsuser2", sym));
-  }
-
-  xpool_tester()
-  {
-    basic_setup();
-    create_core_token();
-    deploy_system_contract();
-    init_accounts();
-
-    setup_token_EOS();
-    setup_token_USDT();
-    setup_token_USDE();
-    setup_token_EOSDT();
-    setup_token_DMD();
-    setup_token_RAB();
-    deploy_xpool();
-    setup_token_AAA();
-  }
-
-  transaction_trace_ptr create_account_with_resources(account_name a, account_name creator, asset ramfunds, bool multisig,
-                                                      asset net = core_sym::from_string("10.0000"), asset cpu = core_sym::from_string("10.0000"))
-  {
-    signed_transaction trx;
-    set_transaction_headers(trx);
-
-    authority owner_auth;
-    if (multisig)
-    {
-      // multisig between account's owner key and creators active permission
-      owner_auth = authority(2, {key_weight{get_public_key(a, "owner"), 1}}, {permission_level_weight{{creator, config::active_name}, 1}});
-    }
-    else
-    {
-      owner_auth = authority(get_public_key(a, "owner"));
-    }
-
-    trx.actions.emplace_back(vector<permission_level>{{creator, config::active_name}},
-                             newaccount{
-                                 .creator = creator,
-                                 .name = a,
-                                 .owner = owner_auth,
-                                 .active = authority(get_public_key(a, "active"))});
-
-    trx.actions.emplace_back(get_action(config::system_account_name, N(buyram), vector<permission_level>{{creator, config::active_name}},
-                                        mvo()("payer", creator)("receiver", a)("quant", ramfunds)));
-
-    trx.actions.emplace_back(get_action(config::system_account_name, N(delegatebw), vector<permission_level>{{creator, config::active_name}},
-                                        mvo()("from", creator)("receiver", a)("stake_net_quantity", net)("stake_cpu_quantity", cpu)("transfer", 0)));
-
-    set_transaction_headers(trx);
-    trx.sign(get_private_key(creator, "active"), control->get_chain_id());
-    return push_transaction(trx);
-  }
-
-  vector<char> get_row_by_primary_key(name code, name scope, name table, const uint64_t key) const
-  {
-    vector<char> data;
-    const auto &db = control->db();
-    const auto *t_id = db.find<chain::table_id_object, chain::by_code_scope_table>(boost::make_tuple(code, scope, table));
-    if (!t_id)
-    {
-      return data;
-    }
-    FC_ASSERT(t_id != 0, "object not found");
-    const auto &idx = db.get_index<chain::key_value_index, chain::by_scope_primary>();
-
-    auto itr = idx.lower_bound(boost::make_tuple(t_id->id, key));
-    if (itr == idx.end() || itr->t_id != t_id->id || key != itr->primary_key)
-    {
-      return data;
-    }
-
-    data.resize(itr->value.size());
-    memcpy(data.data(), itr->value.data(), data.size());
-    return data;
-  }
-
-  asset get_token_balance(const name code, const account_name &act, symbol balance_symbol = symbol{CORE_SYM})
-  {
-    vector<char> data = get_row_by_account(code, act, N(accounts), account_name(balance_symbol.to_symbol_code().value));
-    return data.empty() ? asset(0, balance_symbol) : abi_token_ser.binary_to_variant("account", data, abi_serializer::create_yield_function(abi_serializer_max_time))["balance"].as<asset>();
-  }
-
-  asset get_token_balance(const name code, std::string_view act, symbol balance_symbol = symbol{CORE_SYM})
-  {
-    return get_token_balance(code, account_name(act), balance_symbol);
-  }
-
-  action_result push_xpool_action(const account_name &signer, const action_name &name, const variant_object &data)
-  {
-    string action_type_name = abi_xpool_ser.get_action_type(name);
-
-    action act;
-    act.account = N(rabbitspoolx);
-    act.name = name;
-    act.data = abi_xpool_ser.variant_to_binary(action_type_name, data, abi_serializer::create_yield_function(abi_serializer_max_time));
-
-    return base_tester::push_action(std::move(act), signer.to_uint64_t());
-  }
-
-  fc::variant get_xpool_pool(const uint64_t pool_id)
-  {
-    vector<char> data = get_row_by_primary_key(N(rabbitspoolx), N(rabbitspoolx), N(pools), pool_id);
-    if (data.empty())
-      std::cout << "\nData is empty\n"
-                << std::endl;
-    return data.empty() ? fc::variant() : abi_xpool_ser.binary_to_variant("pool", data, abi_serializer::create_yield_function(abi_serializer_max_time));
-  }
-
-  fc::variant get_xpool_miner(const name owner, const uint64_t pool_id)
-  {
-    vector<char> data = get_row_by_account(N(rabbitspoolx), name(pool_id), N(miners), owner);
-    if (data.empty())
-      std::cout << "\nData is empty\n"
-                << std::endl;
-    return data.empty() ? fc::variant() : abi_xpool_ser.binary_to_variant("miner", data, abi_serializer::create_yield_function(abi_serializer_max_time));
-  }
-
-  action_result xpool_create(name contract, symbol sym, asset reward, uint32_t epoch_time, uint32_t duration, asset min_staked, uint8_t type)
-  {
-    return push_xpool_action(N(rabbitsadmin), N(create), mvo()("contract", contract)("sym", sym)("reward", reward)("epoch_time", epoch_time)("duration", duration)("min_staked", min_staked)("type", type));
-  }
-
-  action_result xpool_claim(name owner, uint64_t pool_id)
-  {
-    return push_xpool_action(owner, N(claim), mvo()("owner", owner)("pool_id", pool_id));
-  }
-
-  action_result xpool_harvest(uint64_t pool_id, uint32_t nonce)
-  {
-    return push_xpool_action(N(rabbitsadmin), N(harvest), mvo()("pool_id", pool_id)("nonce", nonce));
-  }
-
-  abi_serializer abi_token_ser;
-  abi_serializer abi_xpool_ser;
-  abi_serializer abi_system_ser;
-};
+#include "xpool_tester.hpp"
 
 BOOST_AUTO_TEST_SUITE(xpool_tests)
 
@@ -485,6 +102,8 @@ try
   BOOST_REQUIRE_EQUAL(pool["min_staked"], "0.0200000000 DMD");
   BOOST_REQUIRE_EQUAL(pool["last_harvest_time"], epoch);
 
+  BOOST_REQUIRE_EQUAL(wasm_assert_msg("RAM pool must stake EOS"),
+                      xpool_create(N(tethertether), symbol(SY(4, USDT)), asset::from_string("2700.0000 CAT"), epoch, duration, asset::from_string("1.0000 USDT"), 1));
   BOOST_REQUIRE_EQUAL(success(),
                       xpool_create(N(eosio.token), symbol(SY(4, EOS)), asset::from_string("2700.0000 CAT"), epoch, duration, asset::from_string("1.0000 EOS"), 1));
 
@@ -500,6 +119,24 @@ try
   BOOST_REQUIRE_EQUAL(pool["duration"], duration);
   BOOST_REQUIRE_EQUAL(pool["min_staked"], "1.0000 EOS");
   BOOST_REQUIRE_EQUAL(pool["last_harvest_time"], epoch);
+
+  // the EOS and RAM pools share one registry entry
+  auto token = get_xpool_token(N(eosio.token));
+  BOOST_REQUIRE_EQUAL(token["syms"].get_array().size(), 1);
+  BOOST_REQUIRE_EQUAL(token["syms"].get_array()[0], "4,EOS");
+  BOOST_REQUIRE_EQUAL(get_xpool_token(N(tethertether))["syms"].get_array().size(), 1);
+
+  auto global = get_xpool_global();
+  BOOST_REQUIRE_EQUAL(global["allocated_reward"], "19760.0000 CAT");
+  BOOST_REQUIRE_EQUAL(global["pool_count"], 6);
+  BOOST_REQUIRE_EQUAL(wasm_assert_msg("Reach the max circulation"),
+                      xpool_create(N(tokenacctaaa), symbol(SY(4, AAA)), asset::from_string("1240.0001 CAT"), epoch, duration, asset::from_string("1.0000 AAA"), 0));
+
+  // Every pool was created with its bytoken entry
+  BOOST_REQUIRE_EQUAL(error("missing authority of rabbitsadmin"),
+                      push_xpool_action(N(eosio), N(migrate), mvo()));
+  BOOST_REQUIRE_EQUAL(wasm_assert_msg("Nothing to migrate"),
+                      push_xpool_action(N(rabbitsadmin), N(migrate), mvo()));
 }
 FC_LOG_AND_RETHROW()
 
@@ -532,8 +169,9 @@ try
 
   // Deposit
   BOOST_REQUIRE_EQUAL(success(), tf_token(N(eosio.token), N(rabbitsuser1), N(rabbitspoolx), asset::from_string("10.0000 EOS"), ""));
-  BOOST_REQUIRE_EQUAL(asset::from_string("1.0000 EOS"), get_token_balance(N(eosio.token), "rabbitsadmin", symbol(SY(4, EOS))));
-  BOOST_REQUIRE_EQUAL(asset::from_string("0.0000 EOS"), get_token_balance(N(eosio.token), "rabbitspoolx", symbol(SY(4, EOS))));
+  BOOST_REQUIRE_EQUAL(asset::from_string("0.0000 EOS"), get_token_balance(N(eosio.token), "rabbitsadmin", symbol(SY(4, EOS))));
+  BOOST_REQUIRE_EQUAL(asset::from_string("1.0000 EOS"), get_token_balance(N(eosio.token), "rabbitspoolx", symbol(SY(4, EOS))));
+  BOOST_REQUIRE_EQUAL(asset::from_string("1.0000 EOS"), get_xpool_fee(N(eosio.token), symbol(SY(4, EOS))));
   BOOST_REQUIRE_EQUAL(asset::from_string("9999.0000 EOS"), get_token_balance(N(eosio.token), "rabbitsuser1", symbol(SY(4, EOS))));
 
   auto miner = get_xpool_miner(N(rabbitsuser1), 1);
@@ -544,8 +182,9 @@ try
 
   // Deposit
   BOOST_REQUIRE_EQUAL(success(), tf_token(N(eosio.token), N(rabbitsuser1), N(rabbitspoolx), asset::from_string("10.0000 EOS"), ""));
-  BOOST_REQUIRE_EQUAL(asset::from_string("2.0000 EOS"), get_token_balance(N(eosio.token), "rabbitsadmin", symbol(SY(4, EOS))));
-  BOOST_REQUIRE_EQUAL(asset::from_string("0.0000 EOS"), get_token_balance(N(eosio.token), "rabbitspoolx", symbol(SY(4, EOS))));
+  BOOST_REQUIRE_EQUAL(asset::from_string("0.0000 EOS"), get_token_balance(N(eosio.token), "rabbitsadmin", symbol(SY(4, EOS))));
+  BOOST_REQUIRE_EQUAL(asset::from_string("2.0000 EOS"), get_token_balance(N(eosio.token), "rabbitspoolx", symbol(SY(4, EOS))));
+  BOOST_REQUIRE_EQUAL(asset::from_string("2.0000 EOS"), get_xpool_fee(N(eosio.token), symbol(SY(4, EOS))));
   BOOST_REQUIRE_EQUAL(asset::from_string("9998.0000 EOS"), get_token_balance(N(eosio.token), "rabbitsuser1", symbol(SY(4, EOS))));
 
   miner = get_xpool_miner(N(rabbitsuser1), 1);
@@ -554,10 +193,12 @@ try
   BOOST_REQUIRE_EQUAL(miner["claimed"], "0.0000 CAT");
   BOOST_REQUIRE_EQUAL(miner["unclaimed"], "0.0000 CAT");
 
-  // Deposit RAM
+  // Deposit RAM, the stake is queued until flushram
+  BOOST_REQUIRE_EQUAL(wasm_assert_msg("No queued RAM"), xpool_flushram(10));
   BOOST_REQUIRE_EQUAL(success(), tf_token(N(eosio.token), N(rabbitsuser2), N(rabbitspoolx), asset::from_string("10.0000 EOS"), "1"));
-  BOOST_REQUIRE_EQUAL(asset::from_string("3.0000 EOS"), get_token_balance(N(eosio.token), "rabbitsadmin", symbol(SY(4, EOS))));
-  BOOST_REQUIRE_EQUAL(asset::from_string("0.0000 EOS"), get_token_balance(N(eosio.token), "rabbitspoolx", symbol(SY(4, EOS))));
+  BOOST_REQUIRE_EQUAL(asset::from_string("0.0000 EOS"), get_token_balance(N(eosio.token), "rabbitsadmin", symbol(SY(4, EOS))));
+  BOOST_REQUIRE_EQUAL(asset::from_string("12.0000 EOS"), get_token_balance(N(eosio.token), "rabbitspoolx", symbol(SY(4, EOS))));
+  BOOST_REQUIRE_EQUAL(asset::from_string("3.0000 EOS"), get_xpool_fee(N(eosio.token), symbol(SY(4, EOS))));
   BOOST_REQUIRE_EQUAL(asset::from_string("9990.0000 EOS"), get_token_balance(N(eosio.token), "rabbitsuser2", symbol(SY(4, EOS))));
 
   miner = get_xpool_miner(N(rabbitsuser2), 6);
@@ -565,6 +206,67 @@ try
   BOOST_REQUIRE_EQUAL(miner["staked"], "9.0000 EOS");
   BOOST_REQUIRE_EQUAL(miner["claimed"], "0.0000 CAT");
   BOOST_REQUIRE_EQUAL(miner["unclaimed"], "0.0000 CAT");
+
+  // Log actions are only sent inline by the contract
+  BOOST_REQUIRE_EQUAL(error("missing authority of rabbitspoolx"),
+                      push_xpool_action(N(rabbitsuser1), N(logdeposit), mvo()("owner", "rabbitsuser1")("pool_id", 1)("staked", "9.0000 EOS")("fee", "1.0000 EOS")("settled", "0.0000 CAT")));
+
+  // Sweep dev fees, anyone can push it
+  BOOST_REQUIRE_EQUAL(wasm_assert_msg("No fees"), xpool_sweepfees(N(tethertether), symbol(SY(4, USDT))));
+  BOOST_REQUIRE_EQUAL(success(), xpool_sweepfees(N(eosio.token), symbol(SY(4, EOS))));
+  BOOST_REQUIRE_EQUAL(asset::from_string("3.0000 EOS"), get_token_balance(N(eosio.token), "rabbitsadmin", symbol(SY(4, EOS))));
+  BOOST_REQUIRE_EQUAL(asset::from_string("9.0000 EOS"), get_token_balance(N(eosio.token), "rabbitspoolx", symbol(SY(4, EOS))));
+  BOOST_REQUIRE_EQUAL(asset::from_string("0.0000 EOS"), get_xpool_fee(N(eosio.token), symbol(SY(4, EOS))));
+  BOOST_REQUIRE_EQUAL(wasm_assert_msg("No fees"), xpool_sweepfees(N(eosio.token), symbol(SY(4, EOS))));
+
+  // Flush queued RAM, one buyram per depositor
+  int64_t ram_before, ram_after, net, cpu;
+  control->get_resource_limits_manager().get_account_limits(N(rabbitsuser2), ram_before, net, cpu);
+  BOOST_REQUIRE_EQUAL(success(), tf_token(N(eosio.token), N(rabbitsuser2), N(rabbitspoolx), asset::from_string("10.0000 EOS"), "1"));
+  BOOST_REQUIRE_EQUAL(success(), xpool_flushram(10));
+  BOOST_REQUIRE_EQUAL(asset::from_string("1.0000 EOS"), get_token_balance(N(eosio.token), "rabbitspoolx", symbol(SY(4, EOS))));
+  control->get_resource_limits_manager().get_account_limits(N(rabbitsuser2), ram_after, net, cpu);
+  BOOST_REQUIRE(ram_after > ram_before);
+  BOOST_REQUIRE_EQUAL(wasm_assert_msg("No queued RAM"), xpool_flushram(10));
+
+  BOOST_REQUIRE_EQUAL(success(), tf_token(N(eosio.token), N(rabbitsuser2), N(rabbitspoolx), asset::from_string("10.0000 EOS"), "1"));
+  BOOST_REQUIRE_EQUAL(wasm_assert_msg("RAM batch window not reached"), xpool_flushram(10));
+  produce_blocks(10 * 60 * 2);
+  BOOST_REQUIRE_EQUAL(success(), xpool_flushram(10));
+}
+FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE(fee_deposit_tests, xpool_tester)
+try
+{
+  const uint32_t epoch = 1630426200;
+  const uint32_t duration = 604800;
+  BOOST_REQUIRE_EQUAL(success(),
+                      xpool_create(N(eosio.token), symbol(SY(4, EOS)), asset::from_string("13000.0000 CAT"), epoch, duration, asset::from_string("1.0000 EOS"), 0));
+
+  // the fee stands for ten times its amount
+  BOOST_REQUIRE_EQUAL(wasm_assert_msg("The amount of staked is too small"),
+                      tf_token(N(eosio.token), N(rabbitsuser1), N(rabbitspoolx), asset::from_string("0.0999 EOS"), "fee"));
+
+  // Deposit only the fee, the stake stays with the depositor
+  BOOST_REQUIRE_EQUAL(success(), tf_token(N(eosio.token), N(rabbitsuser1), N(rabbitspoolx), asset::from_string("1.0000 EOS"), "fee"));
+  BOOST_REQUIRE_EQUAL(asset::from_string("1.0000 EOS"), get_token_balance(N(eosio.token), "rabbitspoolx", symbol(SY(4, EOS))));
+  BOOST_REQUIRE_EQUAL(asset::from_string("1.0000 EOS"), get_xpool_fee(N(eosio.token), symbol(SY(4, EOS))));
+  BOOST_REQUIRE_EQUAL(asset::from_string("9999.0000 EOS"), get_token_balance(N(eosio.token), "rabbitsuser1", symbol(SY(4, EOS))));
+
+  auto miner = get_xpool_miner(N(rabbitsuser1), 1);
+  BOOST_REQUIRE_EQUAL(miner["staked"], "9.0000 EOS");
+  BOOST_REQUIRE_EQUAL(get_xpool_pool(1)["total_staked"], "9.0000 EOS");
+
+  // 8999.0000 EOS left cannot back a 9000.0000 EOS stake
+  BOOST_REQUIRE_EQUAL(wasm_assert_msg("Insufficient balance for the stake"),
+                      tf_token(N(eosio.token), N(rabbitsuser1), N(rabbitspoolx), asset::from_string("1000.0000 EOS"), "fee"));
+
+  // both modes add to the same stake
+  BOOST_REQUIRE_EQUAL(success(), tf_token(N(eosio.token), N(rabbitsuser1), N(rabbitspoolx), asset::from_string("10.0000 EOS"), ""));
+  miner = get_xpool_miner(N(rabbitsuser1), 1);
+  BOOST_REQUIRE_EQUAL(miner["staked"], "18.0000 EOS");
+  BOOST_REQUIRE_EQUAL(asset::from_string("9998.0000 EOS"), get_token_balance(N(eosio.token), "rabbitsuser1", symbol(SY(4, EOS))));
 }
 FC_LOG_AND_RETHROW()
 
@@ -588,8 +290,9 @@ try
 
   // rabbitsuser1 deposit
   BOOST_REQUIRE_EQUAL(success(), tf_token(N(eosio.token), N(rabbitsuser1), N(rabbitspoolx), asset::from_string("20.0000 EOS"), ""));
-  BOOST_REQUIRE_EQUAL(asset::from_string("2.0000 EOS"), get_token_balance(N(eosio.token), "rabbitsadmin", symbol(SY(4, EOS))));
-  BOOST_REQUIRE_EQUAL(asset::from_string("0.0000 EOS"), get_token_balance(N(eosio.token), "rabbitspoolx", symbol(SY(4, EOS))));
+  BOOST_REQUIRE_EQUAL(asset::from_string("0.0000 EOS"), get_token_balance(N(eosio.token), "rabbitsadmin", symbol(SY(4, EOS))));
+  BOOST_REQUIRE_EQUAL(asset::from_string("2.0000 EOS"), get_token_balance(N(eosio.token), "rabbitspoolx", symbol(SY(4, EOS))));
+  BOOST_REQUIRE_EQUAL(asset::from_string("2.0000 EOS"), get_xpool_fee(N(eosio.token), symbol(SY(4, EOS))));
   BOOST_REQUIRE_EQUAL(asset::from_string("9998.0000 EOS"), get_token_balance(N(eosio.token), "rabbitsuser1", symbol(SY(4, EOS))));
 
   auto miner1 = get_xpool_miner(N(rabbitsuser1), 1);
@@ -598,10 +301,11 @@ try
   BOOST_REQUIRE_EQUAL(miner1["claimed"], "0.0000 CAT");
   BOOST_REQUIRE_EQUAL(miner1["unclaimed"], "0.0000 CAT");
 
-  // rabbitsuser2 deposit
+  // rabbitsuser2 deposit, the reward released so far all accrues to rabbitsuser1
   BOOST_REQUIRE_EQUAL(success(), tf_token(N(eosio.token), N(rabbitsuser2), N(rabbitspoolx), asset::from_string("20.0000 EOS"), ""));
-  BOOST_REQUIRE_EQUAL(asset::from_string("4.0000 EOS"), get_token_balance(N(eosio.token), "rabbitsadmin", symbol(SY(4, EOS))));
-  BOOST_REQUIRE_EQUAL(asset::from_string("0.0000 EOS"), get_token_balance(N(eosio.token), "rabbitspoolx", symbol(SY(4, EOS))));
+  BOOST_REQUIRE_EQUAL(asset::from_string("0.0000 EOS"), get_token_balance(N(eosio.token), "rabbitsadmin", symbol(SY(4, EOS))));
+  BOOST_REQUIRE_EQUAL(asset::from_string("4.0000 EOS"), get_token_balance(N(eosio.token), "rabbitspoolx", symbol(SY(4, EOS))));
+  BOOST_REQUIRE_EQUAL(asset::from_string("4.0000 EOS"), get_xpool_fee(N(eosio.token), symbol(SY(4, EOS))));
   BOOST_REQUIRE_EQUAL(asset::from_string("9998.0000 EOS"), get_token_balance(N(eosio.token), "rabbitsuser2", symbol(SY(4, EOS))));
 
   auto miner2 = get_xpool_miner(N(rabbitsuser2), 1);
@@ -631,24 +335,26 @@ try
   BOOST_REQUIRE_EQUAL(pool["sym"], "4,EOS");
   BOOST_REQUIRE_EQUAL(pool["total_staked"], "36.0000 EOS");
   BOOST_REQUIRE_EQUAL(pool["total_reward"], "13000.0000 CAT");
-  BOOST_REQUIRE_EQUAL(pool["released_reward"], "630.3584 CAT");
+  BOOST_REQUIRE_EQUAL(pool["released_reward"], "633.1481 CAT");
   BOOST_REQUIRE_EQUAL(pool["epoch_time"], epoch);
   BOOST_REQUIRE_EQUAL(pool["duration"], duration);
   BOOST_REQUIRE_EQUAL(pool["min_staked"], "1.0000 EOS");
 
-  BOOST_REQUIRE_EQUAL(asset::from_string("630.3584 CAT"), get_token_balance(N(rabbitstoken), "rabbitspoolx", symbol(SY(4, CAT))));
+  BOOST_REQUIRE_EQUAL(asset::from_string("633.1481 CAT"), get_token_balance(N(rabbitstoken), "rabbitspoolx", symbol(SY(4, CAT))));
 
   miner1 = get_xpool_miner(N(rabbitsuser1), 1);
   BOOST_REQUIRE_EQUAL(miner1["owner"], "rabbitsuser1");
   BOOST_REQUIRE_EQUAL(miner1["staked"], "18.0000 EOS");
   BOOST_REQUIRE_EQUAL(miner1["claimed"], "0.0000 CAT");
-  BOOST_REQUIRE_EQUAL(miner1["unclaimed"], "315.1792 CAT");
+  BOOST_REQUIRE_EQUAL(miner1["unclaimed"], "0.0000 CAT");
+  BOOST_REQUIRE_EQUAL(asset::from_string("626.7104 CAT"), get_xpool_pending(N(rabbitsuser1), 1));
 
   miner2 = get_xpool_miner(N(rabbitsuser2), 1);
   BOOST_REQUIRE_EQUAL(miner2["owner"], "rabbitsuser2");
   BOOST_REQUIRE_EQUAL(miner2["staked"], "18.0000 EOS");
   BOOST_REQUIRE_EQUAL(miner2["claimed"], "0.0000 CAT");
-  BOOST_REQUIRE_EQUAL(miner2["unclaimed"], "315.1792 CAT");
+  BOOST_REQUIRE_EQUAL(miner2["unclaimed"], "0.0000 CAT");
+  BOOST_REQUIRE_EQUAL(asset::from_string("6.4591 CAT"), get_xpool_pending(N(rabbitsuser2), 1));
 
   // 100 seconds
   produce_blocks(99 * 2);
@@ -659,23 +365,25 @@ try
   BOOST_REQUIRE_EQUAL(pool["sym"], "4,EOS");
   BOOST_REQUIRE_EQUAL(pool["total_staked"], "36.0000 EOS");
   BOOST_REQUIRE_EQUAL(pool["total_reward"], "13000.0000 CAT");
-  BOOST_REQUIRE_EQUAL(pool["released_reward"], "632.4984 CAT");
+  BOOST_REQUIRE_EQUAL(pool["released_reward"], "635.2976 CAT");
   BOOST_REQUIRE_EQUAL(pool["epoch_time"], epoch);
   BOOST_REQUIRE_EQUAL(pool["duration"], duration);
   BOOST_REQUIRE_EQUAL(pool["min_staked"], "1.0000 EOS");
 
-  BOOST_REQUIRE_EQUAL(asset::from_string("632.4984 CAT"), get_token_balance(N(rabbitstoken), "rabbitspoolx", symbol(SY(4, CAT))));
+  BOOST_REQUIRE_EQUAL(asset::from_string("635.2976 CAT"), get_token_balance(N(rabbitstoken), "rabbitspoolx", symbol(SY(4, CAT))));
   miner1 = get_xpool_miner(N(rabbitsuser1), 1);
   BOOST_REQUIRE_EQUAL(miner1["owner"], "rabbitsuser1");
   BOOST_REQUIRE_EQUAL(miner1["staked"], "18.0000 EOS");
   BOOST_REQUIRE_EQUAL(miner1["claimed"], "0.0000 CAT");
-  BOOST_REQUIRE_EQUAL(miner1["unclaimed"], "316.2492 CAT");
+  BOOST_REQUIRE_EQUAL(miner1["unclaimed"], "0.0000 CAT");
+  BOOST_REQUIRE_EQUAL(asset::from_string("627.7744 CAT"), get_xpool_pending(N(rabbitsuser1), 1));
 
   miner2 = get_xpool_miner(N(rabbitsuser2), 1);
   BOOST_REQUIRE_EQUAL(miner2["owner"], "rabbitsuser2");
   BOOST_REQUIRE_EQUAL(miner2["staked"], "18.0000 EOS");
   BOOST_REQUIRE_EQUAL(miner2["claimed"], "0.0000 CAT");
-  BOOST_REQUIRE_EQUAL(miner2["unclaimed"], "316.2492 CAT");
+  BOOST_REQUIRE_EQUAL(miner2["unclaimed"], "0.0000 CAT");
+  BOOST_REQUIRE_EQUAL(asset::from_string("7.5231 CAT"), get_xpool_pending(N(rabbitsuser2), 1));
 
   // 100 seconds
   produce_blocks(100 * 2);
@@ -686,23 +394,25 @@ try
   BOOST_REQUIRE_EQUAL(pool["sym"], "4,EOS");
   BOOST_REQUIRE_EQUAL(pool["total_staked"], "36.0000 EOS");
   BOOST_REQUIRE_EQUAL(pool["total_reward"], "13000.0000 CAT");
-  BOOST_REQUIRE_EQUAL(pool["released_reward"], "634.6384 CAT");
+  BOOST_REQUIRE_EQUAL(pool["released_reward"], "637.4470 CAT");
   BOOST_REQUIRE_EQUAL(pool["epoch_time"], epoch);
   BOOST_REQUIRE_EQUAL(pool["duration"], duration);
   BOOST_REQUIRE_EQUAL(pool["min_staked"], "1.0000 EOS");
-  BOOST_REQUIRE_EQUAL(asset::from_string("634.6384 CAT"), get_token_balance(N(rabbitstoken), "rabbitspoolx", symbol(SY(4, CAT))));
+  BOOST_REQUIRE_EQUAL(asset::from_string("637.4470 CAT"), get_token_balance(N(rabbitstoken), "rabbitspoolx", symbol(SY(4, CAT))));
 
   miner1 = get_xpool_miner(N(rabbitsuser1), 1);
   BOOST_REQUIRE_EQUAL(miner1["owner"], "rabbitsuser1");
   BOOST_REQUIRE_EQUAL(miner1["staked"], "18.0000 EOS");
   BOOST_REQUIRE_EQUAL(miner1["claimed"], "0.0000 CAT");
-  BOOST_REQUIRE_EQUAL(miner1["unclaimed"], "317.3192 CAT");
+  BOOST_REQUIRE_EQUAL(miner1["unclaimed"], "0.0000 CAT");
+  BOOST_REQUIRE_EQUAL(asset::from_string("628.8598 CAT"), get_xpool_pending(N(rabbitsuser1), 1));
 
   miner2 = get_xpool_miner(N(rabbitsuser2), 1);
   BOOST_REQUIRE_EQUAL(miner2["owner"], "rabbitsuser2");
   BOOST_REQUIRE_EQUAL(miner2["staked"], "18.0000 EOS");
   BOOST_REQUIRE_EQUAL(miner2["claimed"], "0.0000 CAT");
-  BOOST_REQUIRE_EQUAL(miner2["unclaimed"], "317.3192 CAT");
+  BOOST_REQUIRE_EQUAL(miner2["unclaimed"], "0.0000 CAT");
+  BOOST_REQUIRE_EQUAL(asset::from_string("8.6085 CAT"), get_xpool_pending(N(rabbitsuser2), 1));
 
   // Claim
   BOOST_REQUIRE_EQUAL(error("missing authority of rabbitsuser2"),
@@ -718,16 +428,439 @@ try
   BOOST_REQUIRE_EQUAL(success(), xpool_claim(N(rabbitsuser2), 1));
   miner2 = get_xpool_miner(N(rabbitsuser2), 1);
   BOOST_REQUIRE_EQUAL(miner2["staked"], "18.0000 EOS");
-  BOOST_REQUIRE_EQUAL(miner2["claimed"], "317.3192 CAT");
+  BOOST_REQUIRE_EQUAL(miner2["claimed"], "8.6085 CAT");
   BOOST_REQUIRE_EQUAL(miner2["unclaimed"], "0.0000 CAT");
-  BOOST_REQUIRE_EQUAL(asset::from_string("317.3192 CAT"), get_token_balance(N(rabbitstoken), "rabbitsuser2", symbol(SY(4, CAT))));
+  // one second has passed since the claim
+  BOOST_REQUIRE_EQUAL(asset::from_string("0.0072 CAT"), get_xpool_pending(N(rabbitsuser2), 1));
+  BOOST_REQUIRE_EQUAL(asset::from_string("8.6085 CAT"), get_token_balance(N(rabbitstoken), "rabbitsuser2", symbol(SY(4, CAT))));
 
   produce_blocks(98 * 2);
   BOOST_REQUIRE_EQUAL(success(), xpool_harvest(1, nonce));
   miner2 = get_xpool_miner(N(rabbitsuser2), 1);
   BOOST_REQUIRE_EQUAL(miner2["staked"], "18.0000 EOS");
-  BOOST_REQUIRE_EQUAL(miner2["claimed"], "317.3192 CAT");
-  BOOST_REQUIRE_EQUAL(miner2["unclaimed"], "0.7133 CAT");
+  BOOST_REQUIRE_EQUAL(miner2["claimed"], "8.6085 CAT");
+  BOOST_REQUIRE_EQUAL(miner2["unclaimed"], "0.0000 CAT");
+  BOOST_REQUIRE_EQUAL(asset::from_string("0.7094 CAT"), get_xpool_pending(N(rabbitsuser2), 1));
+
+  // harvestall accrues every active pool and skips the rest
+  BOOST_REQUIRE_EQUAL(error("missing authority of rabbitsadmin"),
+                      push_xpool_action(N(rabbitsuser1), N(harvestall), mvo()("nonce", nonce)));
+  const auto now_time = control->pending_block_time().sec_since_epoch();
+  BOOST_REQUIRE_EQUAL(success(), xpool_harvestall(nonce));
+  BOOST_REQUIRE_EQUAL(get_xpool_pool(1)["last_harvest_time"], now_time);
+  BOOST_REQUIRE_EQUAL(get_xpool_pool(4)["last_harvest_time"], 1630928988);
+  BOOST_REQUIRE_EQUAL(get_xpool_pool(5)["released_reward"], "0.0000 CAT");
+}
+FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE(claimall_tests, xpool_tester)
+try
+{
+  const uint32_t epoch = 1598889600;
+  const uint32_t duration = 604800;
+  BOOST_REQUIRE_EQUAL(success(),
+                      xpool_create(N(eosio.token), symbol(SY(4, EOS)), asset::from_string("13000.0000 CAT"), epoch, duration, asset::from_string("1.0000 EOS"), 0));
+  BOOST_REQUIRE_EQUAL(success(),
+                      xpool_create(N(tethertether), symbol(SY(4, USDT)), asset::from_string("1930.0000 CAT"), epoch, duration, asset::from_string("1.0000 USDT"), 0));
+  BOOST_REQUIRE_EQUAL(success(),
+                      xpool_create(N(tokenaceosdt), symbol(SY(4, EOSDT)), asset::from_string("1030.0000 CAT"), epoch, duration, asset::from_string("1.0000 EOSDT"), 0));
+
+  BOOST_REQUIRE_EQUAL(error("missing authority of rabbitsuser1"),
+                      push_xpool_action(N(rabbitsuser2), N(claimall), mvo()("owner", N(rabbitsuser1))));
+  BOOST_REQUIRE_EQUAL(wasm_assert_msg("No unclaimed"), xpool_claimall(N(rabbitsuser1)));
+
+  BOOST_REQUIRE_EQUAL(success(), tf_token(N(eosio.token), N(rabbitsuser1), N(rabbitspoolx), asset::from_string("20.0000 EOS"), ""));
+  BOOST_REQUIRE_EQUAL(success(), tf_token(N(tethertether), N(rabbitsuser1), N(rabbitspoolx), asset::from_string("20.0000 USDT"), ""));
+  BOOST_REQUIRE_EQUAL(success(), tf_token(N(tethertether), N(rabbitsuser2), N(rabbitspoolx), asset::from_string("20.0000 USDT"), ""));
+
+  // claimall only visits the pools each owner staked in
+  BOOST_REQUIRE(get_xpool_positions(N(rabbitsuser1)) == vector<uint64_t>({1, 2}));
+  BOOST_REQUIRE(get_xpool_positions(N(rabbitsuser2)) == vector<uint64_t>({2}));
+
+  produce_blocks(100 * 2);
+  BOOST_REQUIRE_EQUAL(success(), xpool_harvest(1, 1));
+  BOOST_REQUIRE_EQUAL(success(), xpool_harvest(2, 1));
+
+  // getpending answers through an inline action and writes nothing
+  BOOST_REQUIRE_EQUAL(wasm_assert_msg("No pools"), xpool_getpending(N(rabbitsuser1), {}));
+  BOOST_REQUIRE_EQUAL(wasm_assert_msg("Pool not exists"), xpool_getpending(N(rabbitsuser1), {1, 9}));
+  const auto harvest_time = get_xpool_pool(1)["last_harvest_time"];
+  auto trace = base_tester::push_action(N(rabbitspoolx), N(getpending), N(rabbitsuser3),
+                                        mvo()("owner", "rabbitsuser1")("pool_ids", vector<uint64_t>{1, 2, 3}));
+  BOOST_REQUIRE_EQUAL(get_xpool_pool(1)["last_harvest_time"], harvest_time);
+
+  const auto pending1 = get_xpool_pending(N(rabbitsuser1), 1);
+  const auto pending2 = get_xpool_pending(N(rabbitsuser1), 2);
+  BOOST_REQUIRE(pending1.get_amount() > 0);
+  BOOST_REQUIRE(pending2.get_amount() > 0);
+
+  // logpending lists the pools in the order asked, with what claim would pay now
+  const auto logs = xpool_logs(trace, N(logpending));
+  BOOST_REQUIRE_EQUAL(1, logs.size());
+  BOOST_REQUIRE_EQUAL(logs[0]["owner"], "rabbitsuser1");
+  const auto &pending = logs[0]["pending"].get_array();
+  BOOST_REQUIRE_EQUAL(3, pending.size());
+  BOOST_REQUIRE_EQUAL(pending[0]["pool_id"], 1);
+  BOOST_REQUIRE_EQUAL(pending[0]["quantity"].as<asset>(), pending1);
+  BOOST_REQUIRE_EQUAL(pending[1]["pool_id"], 2);
+  BOOST_REQUIRE_EQUAL(pending[1]["quantity"].as<asset>(), pending2);
+  BOOST_REQUIRE_EQUAL(pending[2]["pool_id"], 3);
+  BOOST_REQUIRE_EQUAL(pending[2]["quantity"], "0.0000 CAT");
+
+  // One inline transfer covers both pools; pool 3 has no miner row and is skipped
+  BOOST_REQUIRE_EQUAL(success(), xpool_claimall(N(rabbitsuser1)));
+  BOOST_REQUIRE_EQUAL(pending1 + pending2, get_token_balance(N(rabbitstoken), "rabbitsuser1", symbol(SY(4, CAT))));
+
+  auto miner = get_xpool_miner(N(rabbitsuser1), 1);
+  BOOST_REQUIRE_EQUAL(miner["claimed"].as<asset>(), pending1);
+  BOOST_REQUIRE_EQUAL(miner["unclaimed"], "0.0000 CAT");
+  miner = get_xpool_miner(N(rabbitsuser1), 2);
+  BOOST_REQUIRE_EQUAL(miner["claimed"].as<asset>(), pending2);
+  BOOST_REQUIRE_EQUAL(miner["unclaimed"], "0.0000 CAT");
+
+  // rabbitsuser2 is untouched
+  miner = get_xpool_miner(N(rabbitsuser2), 2);
+  BOOST_REQUIRE_EQUAL(miner["claimed"], "0.0000 CAT");
+  BOOST_REQUIRE_EQUAL(miner["unclaimed"], "0.0000 CAT");
+  BOOST_REQUIRE_EQUAL(wasm_assert_msg("No unclaimed"), xpool_claimall(N(rabbitsuser1)));
+
+  // staking more in a pool does not add it twice
+  BOOST_REQUIRE_EQUAL(success(), tf_token(N(eosio.token), N(rabbitsuser1), N(rabbitspoolx), asset::from_string("10.0000 EOS"), ""));
+  BOOST_REQUIRE(get_xpool_positions(N(rabbitsuser1)) == vector<uint64_t>({1, 2}));
+}
+FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE(schedule_tests, xpool_tester)
+try
+{
+  const uint32_t epoch = control->pending_block_time().sec_since_epoch() + 10;
+  const uint32_t duration = 180;
+  const auto reward = asset::from_string("150.0000 CAT");
+  const auto min_staked = asset::from_string("1.0000 EOS");
+
+  BOOST_REQUIRE_EQUAL(wasm_assert_msg("Invalid schedule"),
+                      xpool_create(N(eosio.token), symbol(SY(4, EOS)), reward, epoch, duration, min_staked, 0,
+                                   {xpool_segment(epoch, epoch + 60, 100'0000), xpool_segment(epoch + 60, epoch + 180, 40'0000)}));
+  BOOST_REQUIRE_EQUAL(wasm_assert_msg("Invalid schedule"),
+                      xpool_create(N(eosio.token), symbol(SY(4, EOS)), reward, epoch, duration, min_staked, 0,
+                                   {xpool_segment(epoch, epoch + 60, 100'0000), xpool_segment(epoch + 61, epoch + 180, 50'0000)}));
+  BOOST_REQUIRE_EQUAL(wasm_assert_msg("Invalid schedule"),
+                      xpool_create(N(eosio.token), symbol(SY(4, EOS)), reward, epoch, duration, min_staked, 0,
+                                   {xpool_segment(epoch, epoch + 60, 100'0000), xpool_segment(epoch + 60, epoch + 170, 50'0000)}));
+
+  // the first minute releases at twice the rate of the next two
+  BOOST_REQUIRE_EQUAL(success(),
+                      xpool_create(N(eosio.token), symbol(SY(4, EOS)), reward, epoch, duration, min_staked, 0,
+                                   {xpool_segment(epoch, epoch + 60, 100'0000), xpool_segment(epoch + 60, epoch + 180, 50'0000)}));
+  BOOST_REQUIRE_EQUAL(2, get_xpool_pool(1)["schedule"].get_array().size());
+
+  // create without a schedule, as callers from before it existed send it, releases evenly
+  BOOST_REQUIRE_EQUAL(success(),
+                      push_xpool_action(N(rabbitsadmin), N(create), mvo()("contract", N(tethertether))("sym", "4,USDT")("reward", reward)("epoch_time", epoch)("duration", duration)("min_staked", asset::from_string("1.0000 USDT"))("type", 0)));
+  BOOST_REQUIRE_EQUAL(0, get_xpool_pool(2)["schedule"].get_array().size());
+
+  // 9.6000 EOS staked divides the reward evenly
+  BOOST_REQUIRE_EQUAL(success(), tf_token(N(eosio.token), N(rabbitsuser1), N(rabbitspoolx), asset::from_string("10.6666 EOS"), ""));
+  produce_blocks(200 * 2);
+  BOOST_REQUIRE_EQUAL(success(), xpool_claim(N(rabbitsuser1), 1));
+
+  // the whole reward is released, no per-second rounding is left behind
+  BOOST_REQUIRE_EQUAL(get_xpool_pool(1)["released_reward"], "150.0000 CAT");
+  auto miner = get_xpool_miner(N(rabbitsuser1), 1);
+  BOOST_REQUIRE_EQUAL(miner["staked"], "9.6000 EOS");
+  BOOST_REQUIRE_EQUAL(miner["claimed"], "150.0000 CAT");
+}
+FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE(proof_tests, xpool_tester)
+try
+{
+  const uint32_t epoch = 1630426200;
+  const uint32_t duration = 604800;
+  BOOST_REQUIRE_EQUAL(success(),
+                      xpool_create(N(eosio.token), symbol(SY(4, EOS)), asset::from_string("13000.0000 CAT"), epoch, duration, asset::from_string("1.0000 EOS"), 0));
+
+  // three leaves: the first two pair up and the third moves up unchanged
+  const auto leaf1 = xpool_leaf(N(rabbitsuser1), 1, 1, 100'0000);
+  const auto leaf2 = xpool_leaf(N(rabbitsuser2), 1, 1, 50'0000);
+  const auto leaf3 = xpool_leaf(N(rabbitsuser3), 1, 1, 25'0000);
+  const auto node12 = xpool_hash_pair(leaf1, leaf2);
+  const auto root = xpool_hash_pair(node12, leaf3);
+  const auto total = asset::from_string("175.0000 CAT");
+
+  BOOST_REQUIRE_EQUAL(error("missing authority of rabbitsadmin"),
+                      push_xpool_action(N(rabbitsuser1), N(setroot), mvo()("pool_id", 1)("epoch", 1)("root", root)("total", total)));
+  BOOST_REQUIRE_EQUAL(wasm_assert_msg("Pool not exists"), xpool_setroot(9, 1, root, total));
+  BOOST_REQUIRE_EQUAL(wasm_assert_msg("Invalid total"), xpool_setroot(1, 1, root, asset::from_string("0.0000 CAT")));
+  BOOST_REQUIRE_EQUAL(wasm_assert_msg("Distribution exceeds unreleased reward"),
+                      xpool_setroot(1, 1, root, asset::from_string("13000.0001 CAT")));
+  BOOST_REQUIRE_EQUAL(success(), xpool_setroot(1, 1, root, total));
+  BOOST_REQUIRE_EQUAL(wasm_assert_msg("Root exists"), xpool_setroot(1, 1, root, total));
+  BOOST_REQUIRE_EQUAL(get_xpool_pool(1)["distributed"], "175.0000 CAT");
+
+  // every epoch counts against the same unreleased reward
+  BOOST_REQUIRE_EQUAL(wasm_assert_msg("Distribution exceeds unreleased reward"),
+                      xpool_setroot(1, 2, root, asset::from_string("12825.0001 CAT")));
+  // a root with a single leaf is the leaf itself
+  const auto leaf_epoch2 = xpool_leaf(N(rabbitsuser1), 1, 2, 12825'0000);
+  BOOST_REQUIRE_EQUAL(success(), xpool_setroot(1, 2, leaf_epoch2, asset::from_string("12825.0000 CAT")));
+  BOOST_REQUIRE_EQUAL(wasm_assert_msg("Distribution exceeds unreleased reward"),
+                      xpool_setroot(1, 3, root, asset::from_string("0.0001 CAT")));
+
+  BOOST_REQUIRE_EQUAL(wasm_assert_msg("Root not exists"),
+                      xpool_claimproof(N(rabbitsuser1), 1, 3, asset::from_string("100.0000 CAT"), {leaf2, leaf3}));
+  BOOST_REQUIRE_EQUAL(wasm_assert_msg("Invalid proof"),
+                      xpool_claimproof(N(rabbitsuser1), 1, 1, asset::from_string("101.0000 CAT"), {leaf2, leaf3}));
+  BOOST_REQUIRE_EQUAL(success(), xpool_claimproof(N(rabbitsuser1), 1, 1, asset::from_string("100.0000 CAT"), {leaf2, leaf3}));
+  BOOST_REQUIRE_EQUAL(asset::from_string("100.0000 CAT"), get_token_balance(N(rabbitstoken), "rabbitsuser1", symbol(SY(4, CAT))));
+  BOOST_REQUIRE_EQUAL(wasm_assert_msg("Already claimed"),
+                      xpool_claimproof(N(rabbitsuser1), 1, 1, asset::from_string("100.0000 CAT"), {leaf2, leaf3}));
+
+  BOOST_REQUIRE_EQUAL(success(), xpool_claimproof(N(rabbitsuser3), 1, 1, asset::from_string("25.0000 CAT"), {node12}));
+  BOOST_REQUIRE_EQUAL(asset::from_string("25.0000 CAT"), get_token_balance(N(rabbitstoken), "rabbitsuser3", symbol(SY(4, CAT))));
+
+  // claims are kept per owner and epoch, so a claim in one epoch leaves the next one open
+  BOOST_REQUIRE_EQUAL(success(), xpool_claimproof(N(rabbitsuser1), 1, 2, asset::from_string("12825.0000 CAT"), {}));
+  BOOST_REQUIRE_EQUAL(asset::from_string("12925.0000 CAT"), get_token_balance(N(rabbitstoken), "rabbitsuser1", symbol(SY(4, CAT))));
+  BOOST_REQUIRE_EQUAL(wasm_assert_msg("Already claimed"),
+                      xpool_claimproof(N(rabbitsuser1), 1, 2, asset::from_string("12825.0000 CAT"), {}));
+}
+FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE(proof_cap_tests, xpool_tester)
+try
+{
+  // 10 CAT a second once mining starts
+  const uint32_t epoch = control->pending_block_time().sec_since_epoch() + 10;
+  const uint32_t duration = 180;
+  BOOST_REQUIRE_EQUAL(success(),
+                      xpool_create(N(eosio.token), symbol(SY(4, EOS)), asset::from_string("1800.0000 CAT"), epoch, duration, asset::from_string("1.0000 EOS"), 0));
+  BOOST_REQUIRE_EQUAL(success(), tf_token(N(eosio.token), N(rabbitsuser1), N(rabbitspoolx), asset::from_string("10.0000 EOS"), ""));
+  produce_blocks(20 * 2);
+
+  // the first root settles accrual up to now, then the pool stops accruing
+  const auto root = xpool_leaf(N(rabbitsuser2), 1, 1, 100'0000);
+  BOOST_REQUIRE_EQUAL(success(), xpool_setroot(1, 1, root, asset::from_string("100.0000 CAT")));
+  auto pool = get_xpool_pool(1);
+  const auto released = pool["released_reward"].as<asset>();
+  const auto harvest_time = pool["last_harvest_time"];
+  BOOST_REQUIRE(released.get_amount() > 0);
+  BOOST_REQUIRE_EQUAL(pool["distributed"], "100.0000 CAT");
+
+  // harvest has nothing to do once the pool pays through roots, harvestall passes it by;
+  // deposits still move the stake the next roots are shared by
+  produce_blocks(20 * 2);
+  BOOST_REQUIRE_EQUAL(wasm_assert_msg("Pool pays through merkle roots"), xpool_harvest(1, 1));
+  BOOST_REQUIRE_EQUAL(success(), xpool_harvestall(1));
+  BOOST_REQUIRE_EQUAL(success(), tf_token(N(eosio.token), N(rabbitsuser2), N(rabbitspoolx), asset::from_string("10.0000 EOS"), ""));
+  pool = get_xpool_pool(1);
+  BOOST_REQUIRE_EQUAL(pool["released_reward"].as<asset>(), released);
+  BOOST_REQUIRE_EQUAL(pool["last_harvest_time"], harvest_time);
+  BOOST_REQUIRE_EQUAL(pool["total_staked"], "18.0000 EOS");
+
+  // what accrued before the root is still claimed the usual way
+  BOOST_REQUIRE_EQUAL(success(), xpool_claim(N(rabbitsuser1), 1));
+  const auto claimed = get_xpool_miner(N(rabbitsuser1), 1)["claimed"].as<asset>();
+  BOOST_REQUIRE(claimed.get_amount() > 0 && claimed <= released);
+  BOOST_REQUIRE_EQUAL(wasm_assert_msg("No unclaimed"), xpool_claim(N(rabbitsuser2), 1));
+
+  // roots share out what accrual did not release
+  const auto remaining = asset::from_string("1700.0000 CAT") - released;
+  BOOST_REQUIRE_EQUAL(wasm_assert_msg("Distribution exceeds unreleased reward"),
+                      xpool_setroot(1, 2, root, remaining + asset::from_string("0.0001 CAT")));
+  BOOST_REQUIRE_EQUAL(success(), xpool_setroot(1, 2, root, remaining));
+  BOOST_REQUIRE_EQUAL(get_xpool_pool(1)["distributed"].as<asset>(), asset::from_string("100.0000 CAT") + remaining);
+}
+FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE(merkle_tool_tests, xpool_tester)
+try
+{
+  const uint32_t epoch = 1630426200;
+  const uint32_t duration = 604800;
+  BOOST_REQUIRE_EQUAL(success(),
+                      xpool_create(N(eosio.token), symbol(SY(4, EOS)), asset::from_string("13000.0000 CAT"), epoch, duration, asset::from_string("1.0000 EOS"), 0));
+
+  // root printed by xpool-merkle for pool 1, epoch 1 over [1630426200, 1630426250)
+  // and 100.0000 CAT over tools/xpool-snapshot/sample.jsonl; the
+  // xpool_merkle_threads tool test pins it too
+  const fc::sha256 root("1c1939748eeb098ba399c437af1501f33b0edbc74be28366ac3ef08c645fddd5");
+  BOOST_REQUIRE_EQUAL(success(), xpool_setroot(1, 1, root, asset::from_string("100.0000 CAT")));
+
+  std::ifstream proofs(contracts::merkle_sample_proofs());
+  BOOST_REQUIRE_MESSAGE(proofs.good(), "cannot open " << contracts::merkle_sample_proofs());
+  std::string line;
+  size_t claims = 0;
+  while (std::getline(proofs, line))
+  {
+    const auto entry = fc::json::from_string(line).get_object();
+    const auto owner = entry["owner"].as<name>();
+    const auto amount = entry["amount"].as<asset>();
+    BOOST_REQUIRE_EQUAL(success(), xpool_claimproof(owner, entry["pool_id"].as_uint64(), entry["epoch"].as_uint64(), amount,
+                                                    entry["proof"].as<vector<fc::sha256>>()));
+    BOOST_REQUIRE_EQUAL(amount, get_token_balance(N(rabbitstoken), owner.to_string(), symbol(SY(4, CAT))));
+    claims++;
+  }
+  BOOST_REQUIRE_EQUAL(3, claims);
+}
+FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE(row_cache_tests, xpool_tester)
+try
+{
+  // 10 CAT a second once mining starts
+  const uint32_t epoch = control->pending_block_time().sec_since_epoch() + 10;
+  const uint32_t duration = 180;
+  BOOST_REQUIRE_EQUAL(success(),
+                      xpool_create(N(eosio.token), symbol(SY(4, EOS)), asset::from_string("1800.0000 CAT"), epoch, duration, asset::from_string("1.0000 EOS"), 0));
+  BOOST_REQUIRE_EQUAL(success(), tf_token(N(eosio.token), N(rabbitsuser1), N(rabbitspoolx), asset::from_string("10.0000 EOS"), ""));
+  produce_blocks(20 * 2);
+
+  // each action writes its cached rows back before the next action in the
+  // transaction reads them: the second deposit sees the stake and unclaimed
+  // reward the first one wrote, and claim pays what both settled
+  const auto deposit = mvo()("from", "rabbitsuser1")("to", "rabbitspoolx")("quantity", "10.0000 EOS")("memo", "");
+  signed_transaction trx;
+  trx.actions.emplace_back(get_action(N(eosio.token), N(transfer), {{N(rabbitsuser1), config::active_name}}, deposit));
+  trx.actions.emplace_back(get_action(N(eosio.token), N(transfer), {{N(rabbitsuser1), config::active_name}}, deposit));
+  trx.actions.emplace_back(get_action(N(rabbitspoolx), N(harvest), {{N(rabbitsadmin), config::active_name}}, mvo()("pool_id", 1)("nonce", 1)));
+  trx.actions.emplace_back(get_action(N(rabbitspoolx), N(claim), {{N(rabbitsuser1), config::active_name}}, mvo()("owner", "rabbitsuser1")("pool_id", 1)));
+  set_transaction_headers(trx);
+  trx.sign(get_private_key(N(rabbitsuser1), "active"), control->get_chain_id());
+  trx.sign(get_private_key(N(rabbitsadmin), "active"), control->get_chain_id());
+  push_transaction(trx);
+  produce_block();
+
+  auto pool = get_xpool_pool(1);
+  BOOST_REQUIRE_EQUAL(pool["total_staked"], "27.0000 EOS");
+  auto miner = get_xpool_miner(N(rabbitsuser1), 1);
+  BOOST_REQUIRE_EQUAL(miner["staked"], "27.0000 EOS");
+  BOOST_REQUIRE_EQUAL(miner["unclaimed"], "0.0000 CAT");
+  const auto claimed = miner["claimed"].as<asset>();
+  BOOST_REQUIRE(claimed.get_amount() > 0 && claimed <= pool["released_reward"].as<asset>());
+  BOOST_REQUIRE_EQUAL(claimed, get_token_balance(N(rabbitstoken), "rabbitsuser1", symbol(SY(4, CAT))));
+}
+FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE(log_tests, xpool_tester)
+try
+{
+  // 10 CAT a second once mining starts
+  const uint32_t epoch = control->pending_block_time().sec_since_epoch() + 10;
+  const uint32_t duration = 180;
+  BOOST_REQUIRE_EQUAL(success(),
+                      xpool_create(N(eosio.token), symbol(SY(4, EOS)), asset::from_string("1800.0000 CAT"), epoch, duration, asset::from_string("1.0000 EOS"), 0));
+
+  // before the epoch a deposit has nothing to accrue or settle
+  auto trace = base_tester::push_action(N(eosio.token), N(transfer), N(rabbitsuser1),
+                                        mvo()("from", "rabbitsuser1")("to", "rabbitspoolx")("quantity", "10.0000 EOS")("memo", ""));
+  BOOST_REQUIRE_EQUAL(0, xpool_logs(trace, N(logharvest)).size());
+  auto logs = xpool_logs(trace, N(logdeposit));
+  BOOST_REQUIRE_EQUAL(1, logs.size());
+  BOOST_REQUIRE_EQUAL(logs[0]["owner"], "rabbitsuser1");
+  BOOST_REQUIRE_EQUAL(logs[0]["pool_id"], 1);
+  BOOST_REQUIRE_EQUAL(logs[0]["staked"], "9.0000 EOS");
+  BOOST_REQUIRE_EQUAL(logs[0]["fee"], "1.0000 EOS");
+  BOOST_REQUIRE_EQUAL(logs[0]["settled"], "0.0000 CAT");
+  produce_blocks(20 * 2);
+
+  // harvest reports exactly what it moved the poolstats row by
+  trace = base_tester::push_action(N(rabbitspoolx), N(harvest), N(rabbitsadmin), mvo()("pool_id", 1)("nonce", 1));
+  auto pool = get_xpool_pool(1);
+  logs = xpool_logs(trace, N(logharvest));
+  BOOST_REQUIRE_EQUAL(1, logs.size());
+  BOOST_REQUIRE_EQUAL(logs[0]["pool_id"], 1);
+  BOOST_REQUIRE_EQUAL(logs[0]["released"].as<asset>(), pool["released_reward"].as<asset>());
+  BOOST_REQUIRE(logs[0]["acc_reward_per_share"].as<uint128_t>() == pool["acc_reward_per_share"].as<uint128_t>());
+  BOOST_REQUIRE_EQUAL(logs[0]["harvest_time"], pool["last_harvest_time"]);
+  BOOST_REQUIRE(pool["released_reward"].as<asset>().get_amount() > 0);
+  produce_blocks(2);
+
+  // a second deposit accrues the pool and settles the miner's pending reward
+  auto released = get_xpool_pool(1)["released_reward"].as<asset>();
+  trace = base_tester::push_action(N(eosio.token), N(transfer), N(rabbitsuser1),
+                                   mvo()("from", "rabbitsuser1")("to", "rabbitspoolx")("quantity", "10.0000 EOS")("memo", ""));
+  pool = get_xpool_pool(1);
+  logs = xpool_logs(trace, N(logharvest));
+  BOOST_REQUIRE_EQUAL(1, logs.size());
+  BOOST_REQUIRE_EQUAL(logs[0]["released"].as<asset>(), pool["released_reward"].as<asset>() - released);
+  BOOST_REQUIRE_EQUAL(logs[0]["harvest_time"], pool["last_harvest_time"]);
+  logs = xpool_logs(trace, N(logdeposit));
+  BOOST_REQUIRE_EQUAL(1, logs.size());
+  BOOST_REQUIRE_EQUAL(logs[0]["staked"], "9.0000 EOS");
+  BOOST_REQUIRE_EQUAL(logs[0]["fee"], "1.0000 EOS");
+  BOOST_REQUIRE_EQUAL(logs[0]["settled"].as<asset>(), get_xpool_miner(N(rabbitsuser1), 1)["unclaimed"].as<asset>());
+  BOOST_REQUIRE(logs[0]["settled"].as<asset>().get_amount() > 0);
+  produce_blocks(2);
+
+  // claim logs what it transferred
+  const auto balance = get_token_balance(N(rabbitstoken), "rabbitsuser1", symbol(SY(4, CAT)));
+  trace = base_tester::push_action(N(rabbitspoolx), N(claim), N(rabbitsuser1), mvo()("owner", "rabbitsuser1")("pool_id", 1));
+  logs = xpool_logs(trace, N(logclaim));
+  BOOST_REQUIRE_EQUAL(1, logs.size());
+  BOOST_REQUIRE_EQUAL(logs[0]["owner"], "rabbitsuser1");
+  BOOST_REQUIRE_EQUAL(logs[0]["pool_id"], 1);
+  BOOST_REQUIRE_EQUAL(logs[0]["quantity"].as<asset>(), get_token_balance(N(rabbitstoken), "rabbitsuser1", symbol(SY(4, CAT))) - balance);
+  BOOST_REQUIRE_EQUAL(logs[0]["quantity"].as<asset>(), get_xpool_miner(N(rabbitsuser1), 1)["claimed"].as<asset>());
+}
+FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE(legacy_tests, xpool_tester)
+try
+{
+  // a pools row as the baseline contract wrote it, ending at last_harvest_time
+  const uint32_t epoch = 1596626691;
+  const uint32_t duration = 604800;
+  set_row(N(rabbitspoolx), N(rabbitspoolx), N(pools), 1,
+          pack_row(uint64_t(1), uint8_t(0), N(eosio.token), symbol(SY(4, EOS)), asset::from_string("9.0000 EOS"),
+                   asset::from_string("13000.0000 CAT"), asset::from_string("0.0000 CAT"), epoch, duration,
+                   asset::from_string("1.0000 EOS"), epoch));
+  produce_blocks(1);
+
+  auto pool = get_xpool_pool(1);
+  BOOST_REQUIRE_EQUAL(pool["total_staked"], "9.0000 EOS");
+  BOOST_REQUIRE_EQUAL(pool["total_reward"], "13000.0000 CAT");
+  BOOST_REQUIRE_EQUAL(pool["last_harvest_time"], epoch);
+  BOOST_REQUIRE_EQUAL(pool.get_object().contains("acc_reward_per_share"), false);
+
+  // the contract reads the same row, with the accumulator starting from 0
+  BOOST_REQUIRE_EQUAL(success(), xpool_getpending(N(rabbitsuser1), {1}));
+
+  // a miners row as the baseline contract wrote it: owner and three assets
+  set_row(N(rabbitspoolx), name(1), N(miners), N(rabbitsuser1).to_uint64_t(),
+          pack_row(N(rabbitsuser1), asset::from_string("9.0000 EOS"), asset::from_string("0.0000 CAT"), asset::from_string("1.5000 CAT")));
+  produce_blocks(1);
+  BOOST_REQUIRE_EQUAL(true, get_row_by_account(N(rabbitspoolx), name(1), N(minersv1), N(rabbitsuser1)).empty());
+
+  // the first touch pays the legacy unclaimed and moves the row to minersv1
+  BOOST_REQUIRE_EQUAL(success(), xpool_claim(N(rabbitsuser1), 1));
+  BOOST_REQUIRE_EQUAL(true, get_row_by_account(N(rabbitspoolx), name(1), N(miners), N(rabbitsuser1)).empty());
+  auto miner = get_xpool_miner(N(rabbitsuser1), 1);
+  BOOST_REQUIRE_EQUAL(miner["staked"], "9.0000 EOS");
+  BOOST_REQUIRE_EQUAL(miner["claimed"], "1.5000 CAT");
+  BOOST_REQUIRE_EQUAL(miner["unclaimed"], "0.0000 CAT");
+  BOOST_REQUIRE(miner["reward_debt"].as<uint128_t>() == 0);
+  BOOST_REQUIRE_EQUAL(asset::from_string("1.5000 CAT"), get_token_balance(N(rabbitstoken), "rabbitsuser1", symbol(SY(4, CAT))));
+
+  // the legacy pool has no bytoken entry until migrate rewrites it
+  BOOST_REQUIRE_EQUAL(wasm_assert_msg("Pool not found"),
+                      tf_token(N(eosio.token), N(rabbitsuser2), N(rabbitspoolx), asset::from_string("10.0000 EOS"), ""));
+  BOOST_REQUIRE_EQUAL(success(), push_xpool_action(N(rabbitsadmin), N(migrate), mvo()));
+  BOOST_REQUIRE_EQUAL(wasm_assert_msg("Nothing to migrate"), push_xpool_action(N(rabbitsadmin), N(migrate), mvo()));
+  auto global = get_xpool_global();
+  BOOST_REQUIRE_EQUAL(global["allocated_reward"], "13000.0000 CAT");
+  BOOST_REQUIRE_EQUAL(global["pool_count"], 1);
+
+  pool = get_xpool_pool(1);
+  BOOST_REQUIRE_EQUAL(pool["contract"], "eosio.token");
+  BOOST_REQUIRE_EQUAL(pool["sym"], "4,EOS");
+  BOOST_REQUIRE_EQUAL(pool["epoch_time"], epoch);
+  BOOST_REQUIRE_EQUAL(pool["min_staked"], "1.0000 EOS");
+
+  // and a deposit finds it through bytoken
+  BOOST_REQUIRE_EQUAL(success(), tf_token(N(eosio.token), N(rabbitsuser2), N(rabbitspoolx), asset::from_string("10.0000 EOS"), ""));
+  BOOST_REQUIRE_EQUAL(get_xpool_pool(1)["total_staked"], "18.0000 EOS");
+  BOOST_REQUIRE_EQUAL(get_xpool_miner(N(rabbitsuser2), 1)["staked"], "9.0000 EOS");
 }
 FC_LOG_AND_RETHROW()
 
@@ -0,0 +1,344 @@
+#include <core.hpp>
+
+#include "sha256.hpp"
+#include "../xpool-snapshot/snapshot.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Builds the merkle tree for one epoch of a pool's merkle distribution from
+// a table snapshot (see tools/xpool-snapshot). The epoch's total is shared
+// out over the pool's miners in proportion to the stake each held over the
+// epoch, each share becomes a leaf as in core::leaf_message, and the root is
+// what setroot takes. Leaves and every level of the tree are hashed in
+// parallel.
+//
+// A stake counts from the block time of the deposit that added it, read
+// from the snapshot's logdeposit rows, so a deposit made just before the
+// epoch ends earns only for the seconds it was held. The snapshot is taken
+// at or after the epoch's end and its logdeposit rows cover every deposit
+// from the epoch's start on; stake not accounted for by those rows was held
+// for the whole epoch.
+
+namespace
+{
+  struct options
+  {
+    std::string snapshot;
+    uint64_t pool_id = 0;
+    uint64_t epoch = 0;
+    uint64_t start_time = 0;
+    uint64_t end_time = 0;
+    uint64_t total = 0;
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    size_t min_parallel = 1024; // smaller leaf sets and levels are hashed on one thread
+    std::string proofs;
+    bool check = false;
+  };
+
+  struct leaf
+  {
+    uint64_t owner;
+    uint128_t weight; // stake times the seconds it was held during the epoch
+    uint64_t amount;
+  };
+
+  void usage(const char *prog)
+  {
+    std::cerr << "Usage: " << prog << " [--threads N] [--min-parallel N] [--proofs <out.jsonl>] [--check] <snapshot.bin> <pool_id> <epoch> <start_time> <end_time> <total>\n"
+              << "  the epoch runs over [start_time, end_time) in seconds since 1970\n"
+              << "  total is in the smallest CAT unit, e.g. 10000 for 1.0000 CAT" << std::endl;
+    std::exit(1);
+  }
+
+  options parse_options(int argc, char *argv[])
+  {
+    options opts;
+    std::vector<const char *> args;
+    for (int i = 1; i < argc; i++)
+    {
+      if (std::strcmp(argv[i], "--check") == 0)
+        opts.check = true;
+      else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+        opts.threads = unsigned(std::strtoul(argv[++i], nullptr, 10));
+      else if (std::strcmp(argv[i], "--min-parallel") == 0 && i + 1 < argc)
+        opts.min_parallel = std::strtoull(argv[++i], nullptr, 10);
+      else if (std::strcmp(argv[i], "--proofs") == 0 && i + 1 < argc)
+        opts.proofs = argv[++i];
+      else if (argv[i][0] == '-')
+        usage(argv[0]);
+      else
+        args.push_back(argv[i]);
+    }
+    if (args.size() != 6 || opts.threads == 0)
+      usage(argv[0]);
+    opts.snapshot = args[0];
+    opts.pool_id = std::strtoull(args[1], nullptr, 10);
+    opts.epoch = std::strtoull(args[2], nullptr, 10);
+    opts.start_time = std::strtoull(args[3], nullptr, 10);
+    opts.end_time = std::strtoull(args[4], nullptr, 10);
+    opts.total = std::strtoull(args[5], nullptr, 10);
+    if (opts.end_time <= opts.start_time)
+      usage(argv[0]);
+
+    // the hashing is CPU bound, threads beyond the cores only take turns
+    const auto cores = std::thread::hardware_concurrency();
+    if (cores > 0)
+      opts.threads = std::min(opts.threads, cores);
+    return opts;
+  }
+
+  // runs fn(begin, end) over [0, n) split across threads
+  template <typename Fn>
+  void parallel_for(const size_t n, const options &opts, Fn fn)
+  {
+    const auto threads = opts.threads;
+    const size_t chunk = (n + threads - 1) / threads;
+    if (n < opts.min_parallel || threads == 1)
+    {
+      fn(size_t(0), n);
+      return;
+    }
+    std::vector<std::thread> workers;
+    for (size_t begin = 0; begin < n; begin += chunk)
+      workers.emplace_back(fn, begin, std::min(n, begin + chunk));
+    for (auto &w : workers)
+      w.join();
+  }
+
+  std::string name_to_string(uint64_t value)
+  {
+    static const char *charmap = ".12345abcdefghijklmnopqrstuvwxyz";
+    std::string str(13, '.');
+    for (int i = 0; i <= 12; i++)
+    {
+      str[12 - i] = charmap[value & (i == 0 ? 0x0f : 0x1f)];
+      value >>= (i == 0 ? 4 : 5);
+    }
+    str.erase(str.find_last_not_of('.') + 1);
+    return str;
+  }
+
+  std::string to_hex(const sha256::digest &d)
+  {
+    static const char *digits = "0123456789abcdef";
+    std::string out;
+    for (auto b : d)
+    {
+      out += digits[b >> 4];
+      out += digits[b & 0x0f];
+    }
+    return out;
+  }
+
+  std::string to_cat(const uint64_t amount)
+  {
+    auto frac = std::to_string(amount % 1'0000);
+    return std::to_string(amount / 1'0000) + "." + std::string(4 - frac.size(), '0') + frac + " CAT";
+  }
+
+  // stake-seconds of the pool's miners over the epoch, from both miner table
+  // layouts and the logdeposit rows; leaves come out ordered by owner
+  std::vector<leaf> read_leaves(const snapshot::reader &snap, const options &opts)
+  {
+    const auto period = opts.end_time - opts.start_time;
+    std::map<uint64_t, int64_t> held; // stake in place before start_time
+    std::map<uint64_t, uint128_t> weights;
+    for (const char *table : {"minersv1", "miners"})
+    {
+      auto t = snap.find(table);
+      if (t == nullptr)
+        continue;
+      auto pool_ids = t->column<uint64_t>("pool_id");
+      auto owners = t->column<uint64_t>("owner");
+      auto staked = t->column<int64_t>("staked");
+      for (uint64_t i = 0; i < t->rows(); i++)
+      {
+        if (pool_ids[i] == opts.pool_id && staked[i] > 0)
+          held[owners[i]] += staked[i];
+      }
+    }
+
+    auto deposits = snap.find("logdeposit");
+    if (deposits == nullptr)
+    {
+      std::cout << "no logdeposit rows, every stake counts for the whole epoch" << std::endl;
+    }
+    else
+    {
+      auto times = deposits->column<uint64_t>("time");
+      auto pool_ids = deposits->column<uint64_t>("pool_id");
+      auto owners = deposits->column<uint64_t>("owner");
+      auto staked = deposits->column<int64_t>("staked");
+      for (uint64_t i = 0; i < deposits->rows(); i++)
+      {
+        if (pool_ids[i] != opts.pool_id || times[i] < opts.start_time)
+          continue;
+        held[owners[i]] -= staked[i];
+        if (times[i] < opts.end_time)
+          weights[owners[i]] += uint128_t(staked[i]) * (opts.end_time - times[i]);
+      }
+    }
+
+    std::vector<leaf> leaves;
+    for (const auto &h : held)
+    {
+      if (h.second < 0)
+        throw std::runtime_error("logdeposit rows of " + name_to_string(h.first) + " add up to more than its stake in the snapshot");
+      const auto weight = weights[h.first] + uint128_t(h.second) * period;
+      if (weight > 0)
+        leaves.push_back({h.first, weight, 0});
+    }
+    return leaves;
+  }
+
+  // levels[0] holds the leaf hashes and levels.back() the root
+  std::vector<std::vector<sha256::digest>> build_tree(std::vector<sha256::digest> hashes, const options &opts)
+  {
+    std::vector<std::vector<sha256::digest>> levels;
+    levels.push_back(std::move(hashes));
+    while (levels.back().size() > 1)
+    {
+      const auto &below = levels.back();
+      std::vector<sha256::digest> level((below.size() + 1) / 2);
+      parallel_for(level.size(), opts, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++)
+        {
+          level[i] = 2 * i + 1 < below.size() ? core::hash_pair(below[2 * i], below[2 * i + 1], sha256::hash) : below[2 * i];
+        }
+      });
+      levels.push_back(std::move(level));
+    }
+    return levels;
+  }
+
+  std::vector<sha256::digest> proof_of(const std::vector<std::vector<sha256::digest>> &levels, size_t index)
+  {
+    std::vector<sha256::digest> proof;
+    for (size_t l = 0; l + 1 < levels.size(); l++, index /= 2)
+    {
+      const auto sibling = index ^ 1;
+      if (sibling < levels[l].size())
+        proof.push_back(levels[l][sibling]);
+    }
+    return proof;
+  }
+} // namespace
+
+int main(int argc, char *argv[])
+{
+  const auto opts = parse_options(argc, argv);
+
+  // known answer for "abc", so a broken hash never produces a root
+  const uint8_t abc[] = {'a', 'b', 'c'};
+  if (to_hex(sha256::hash(abc, sizeof(abc))) != "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad")
+  {
+    std::cerr << "sha256 self-test failed" << std::endl;
+    return 1;
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+  std::vector<leaf> leaves;
+  try
+  {
+    snapshot::reader snap(opts.snapshot);
+    leaves = read_leaves(snap, opts);
+  }
+  catch (const std::exception &e)
+  {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+
+  uint128_t total_weight = 0;
+  for (const auto &l : leaves)
+    total_weight += l.weight;
+  if (total_weight == 0)
+  {
+    std::cerr << "no stake in pool " << opts.pool_id << std::endl;
+    return 1;
+  }
+
+  // shares round down, so the leaves never add up to more than the total
+  uint64_t distributed = 0;
+  for (auto &l : leaves)
+  {
+    l.amount = core::distribution_share(opts.total, l.weight, total_weight);
+    distributed += l.amount;
+  }
+  leaves.erase(std::remove_if(leaves.begin(), leaves.end(), [](const leaf &l) { return l.amount == 0; }), leaves.end());
+  if (leaves.empty())
+  {
+    std::cerr << "total too small to give any miner a share" << std::endl;
+    return 1;
+  }
+
+  std::vector<sha256::digest> hashes(leaves.size());
+  parallel_for(leaves.size(), opts, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++)
+    {
+      const auto msg = core::leaf_message(leaves[i].owner, opts.pool_id, opts.epoch, leaves[i].amount);
+      hashes[i] = sha256::hash(msg.data(), msg.size());
+    }
+  });
+  const auto levels = build_tree(std::move(hashes), opts);
+  const auto &root = levels.back()[0];
+
+  if (opts.check)
+  {
+    // fold every proof back up the way claimproof does
+    std::atomic<uint64_t> failed{0};
+    parallel_for(leaves.size(), opts, [&](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; i++)
+      {
+        auto node = levels[0][i];
+        for (const auto &sibling : proof_of(levels, i))
+          node = core::hash_pair(node, sibling, sha256::hash);
+        if (node != root)
+          failed++;
+      }
+    });
+    if (failed > 0)
+    {
+      std::cerr << failed << " proofs do not reach the root" << std::endl;
+      return 1;
+    }
+    std::cout << leaves.size() << " proofs verified" << std::endl;
+  }
+
+  if (!opts.proofs.empty())
+  {
+    std::ofstream out(opts.proofs);
+    for (size_t i = 0; i < leaves.size(); i++)
+    {
+      out << "{\"owner\":\"" << name_to_string(leaves[i].owner) << "\",\"pool_id\":" << opts.pool_id
+          << ",\"epoch\":" << opts.epoch << ",\"amount\":\"" << to_cat(leaves[i].amount) << "\",\"proof\":[";
+      const auto proof = proof_of(levels, i);
+      for (size_t j = 0; j < proof.size(); j++)
+        out << (j > 0 ? "," : "") << "\"" << to_hex(proof[j]) << "\"";
+      out << "]}\n";
+    }
+    if (!out)
+    {
+      std::cerr << "cannot write " << opts.proofs << std::endl;
+      return 1;
+    }
+  }
+  const auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  std::cout << "leaves:          " << leaves.size() << "\n"
+            << "distributed:     " << to_cat(distributed) << "\n"
+            << "root:            " << to_hex(root) << "\n"
+            << "elapsed:         " << elapsed << " s" << std::endl;
+  return 0;
+}
@@ -0,0 +1,185 @@
+#include <core.hpp>
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+// Replays random deposits, harvests and claims against one pool using the
+// contract's reward math, then checks that no more CAT was paid out than
+// the pool released.
+
+namespace
+{
+  struct sim_miner
+  {
+    uint64_t staked = 0;
+    uint64_t claimed = 0;
+    uint64_t unclaimed = 0;
+    uint128_t reward_debt = 0;
+  };
+
+  struct sim_pool
+  {
+    uint64_t total_reward;
+    uint32_t epoch_time;
+    uint32_t duration;
+    uint64_t min_staked;
+    uint64_t dev_fees = 0;
+    core::pool_counters counters{0, 0, 0, {0, 0}};
+  };
+
+  constexpr uint64_t MAX_SUPPLY = 2'1000'0000;
+
+  struct options
+  {
+    uint64_t miners = 1000;
+    uint64_t events = 1'000'000;
+    uint64_t seed = 1;
+  };
+
+  void usage(const char *prog)
+  {
+    std::cerr << "Usage: " << prog << " [--miners N] [--events N] [--seed N]" << std::endl;
+    std::exit(1);
+  }
+
+  options parse_options(int argc, char *argv[])
+  {
+    options opts;
+    for (int i = 1; i < argc; i++)
+    {
+      if (i + 1 >= argc)
+        usage(argv[0]);
+      auto value = std::strtoull(argv[++i], nullptr, 10);
+      if (std::strcmp(argv[i - 1], "--miners") == 0)
+        opts.miners = value;
+      else if (std::strcmp(argv[i - 1], "--events") == 0)
+        opts.events = value;
+      else if (std::strcmp(argv[i - 1], "--seed") == 0)
+        opts.seed = value;
+      else
+        usage(argv[0]);
+    }
+    if (opts.miners == 0)
+      usage(argv[0]);
+    return opts;
+  }
+
+  // the same accrual step as xpool::accrue, over a flat emission
+  void harvest(sim_pool &p, const uint32_t now_time)
+  {
+    const core::segment flat{p.epoch_time, p.epoch_time + p.duration, p.total_reward};
+    core::accrue_pool(p.counters, flat.end_time, now_time, [&](const uint32_t time) { return core::emitted(flat, time); });
+  }
+
+  // deposits and claims accrue the pool first, as the contract does
+  void deposit(sim_pool &p, sim_miner &m, const uint64_t quantity, const uint32_t now_time)
+  {
+    harvest(p, now_time);
+    auto split = core::split_deposit(quantity);
+    p.dev_fees = safemath::add(p.dev_fees, split.to_dev);
+    p.counters.total_staked = safemath::add(p.counters.total_staked, split.to_stake);
+    auto staked = safemath::add(m.staked, split.to_stake);
+    m.unclaimed = safemath::add(m.unclaimed, core::pending_reward(p.counters.acc.acc_reward_per_share, m.staked, m.reward_debt, MAX_SUPPLY));
+    m.reward_debt = core::reward_debt(p.counters.acc.acc_reward_per_share, m.staked, m.reward_debt, staked);
+    m.staked = staked;
+  }
+
+  void claim(sim_pool &p, sim_miner &m, const uint32_t now_time)
+  {
+    harvest(p, now_time);
+    auto quantity = safemath::add(m.unclaimed, core::pending_reward(p.counters.acc.acc_reward_per_share, m.staked, m.reward_debt, MAX_SUPPLY));
+    m.claimed = safemath::add(m.claimed, quantity);
+    m.unclaimed = 0;
+    m.reward_debt = core::reward_debt(p.counters.acc.acc_reward_per_share, m.staked, m.reward_debt, m.staked);
+  }
+} // namespace
+
+int main(int argc, char *argv[])
+{
+  const auto opts = parse_options(argc, argv);
+
+  sim_pool pool{13000'0000, 1602936000, 604800, 1'0000};
+  pool.counters.last_harvest_time = pool.epoch_time;
+  std::vector<sim_miner> miners(opts.miners);
+
+  std::mt19937_64 rng(opts.seed);
+  std::uniform_int_distribution<uint64_t> pick_miner(0, opts.miners - 1);
+  std::uniform_int_distribution<int> pick_event(0, 99);
+  std::uniform_int_distribution<uint64_t> pick_amount(pool.min_staked, 1000'0000);
+
+  // spread the events evenly over the mining period
+  const auto seconds_per_event = std::max<uint64_t>(1, pool.duration / opts.events);
+  uint64_t deposits = 0, harvests = 0, claims = 0;
+
+  const auto start = std::chrono::steady_clock::now();
+  try
+  {
+    for (uint64_t i = 0; i < opts.events; i++)
+    {
+      const auto now_time = uint32_t(std::min<uint64_t>(pool.epoch_time + i * seconds_per_event, pool.epoch_time + pool.duration));
+      auto &m = miners[pick_miner(rng)];
+      const auto event = pick_event(rng);
+      if (event < 60)
+      {
+        deposit(pool, m, pick_amount(rng), now_time);
+        deposits++;
+      }
+      else if (event < 90)
+      {
+        harvest(pool, now_time);
+        harvests++;
+      }
+      else
+      {
+        claim(pool, m, now_time);
+        claims++;
+      }
+    }
+    // late claims, a day after the end, must not accrue past it
+    for (auto &m : miners)
+      claim(pool, m, pool.epoch_time + pool.duration + 86400);
+  }
+  catch (const std::exception &e)
+  {
+    std::cerr << "simulation failed: " << e.what() << std::endl;
+    return 1;
+  }
+  const auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  uint64_t paid = 0;
+  for (const auto &m : miners)
+    paid += m.claimed;
+
+  std::cout << "miners:          " << opts.miners << "\n"
+            << "deposits:        " << deposits << "\n"
+            << "harvests:        " << harvests << "\n"
+            << "claims:          " << claims << "\n"
+            << "total staked:    " << pool.counters.total_staked << "\n"
+            << "dev fees:        " << pool.dev_fees << "\n"
+            << "released reward: " << pool.counters.released_reward << "\n"
+            << "paid reward:     " << paid << "\n"
+            << "rounding loss:   " << pool.counters.released_reward - std::min(paid, pool.counters.released_reward) << "\n"
+            << "elapsed:         " << elapsed << "s" << std::endl;
+
+  if (paid > pool.counters.released_reward)
+  {
+    std::cerr << "paid more than released" << std::endl;
+    return 1;
+  }
+  if (pool.counters.last_harvest_time != pool.epoch_time + pool.duration)
+  {
+    std::cerr << "accrued to " << pool.counters.last_harvest_time << ", past the end of mining" << std::endl;
+    return 1;
+  }
+  if (pool.counters.released_reward != pool.total_reward)
+  {
+    std::cerr << "released " << pool.counters.released_reward << " of " << pool.total_reward << std::endl;
+    return 1;
+  }
+  return 0;
+}
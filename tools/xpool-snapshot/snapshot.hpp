@@ -0,0 +1,193 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Columnar snapshot of xpool and eosio.token rows, written by xpool-snapshot.
+// The file is mapped read-only and each column is a plain array of
+// fixed-width little-endian values starting on a 16 byte boundary, so a
+// column can be used in place without parsing:
+//
+//   file_header
+//   table_header, column_header[column_count]    for each table
+//   column data
+namespace snapshot
+{
+  constexpr char MAGIC[8] = {'X', 'P', 'S', 'N', 'A', 'P', '0', '1'};
+  constexpr uint64_t ALIGNMENT = 16;
+
+  struct file_header
+  {
+    char magic[8];
+    uint32_t table_count;
+    uint32_t reserved;
+  };
+
+  struct table_header
+  {
+    char name[16];
+    uint64_t rows;
+    uint32_t column_count;
+    uint32_t reserved;
+  };
+
+  struct column_header
+  {
+    char name[24];
+    uint32_t width;
+    uint32_t reserved;
+    uint64_t offset; // from the start of the file
+  };
+
+  class table_view
+  {
+  public:
+    table_view(const char *base, const table_header *header)
+        : _base(base), _header(header), _columns(reinterpret_cast<const column_header *>(header + 1)) {}
+
+    std::string name() const { return std::string(_header->name, strnlen(_header->name, sizeof(_header->name))); }
+    uint64_t rows() const { return _header->rows; }
+    uint32_t column_count() const { return _header->column_count; }
+    const column_header &column_at(uint32_t i) const { return _columns[i]; }
+
+    bool has_column(const std::string &name) const { return find(name) != nullptr; }
+
+    template <typename T>
+    const T *column(const std::string &name) const
+    {
+      auto c = find(name);
+      if (c == nullptr)
+        throw std::runtime_error("no column " + name + " in table " + this->name());
+      if (c->width != sizeof(T))
+        throw std::runtime_error("column " + name + " is " + std::to_string(c->width) + " bytes wide");
+      return reinterpret_cast<const T *>(_base + c->offset);
+    }
+
+  private:
+    const column_header *find(const std::string &name) const
+    {
+      for (uint32_t i = 0; i < _header->column_count; i++)
+      {
+        if (name == std::string(_columns[i].name, strnlen(_columns[i].name, sizeof(_columns[i].name))))
+          return &_columns[i];
+      }
+      return nullptr;
+    }
+
+    const char *_base;
+    const table_header *_header;
+    const column_header *_columns;
+  };
+
+  class reader
+  {
+  public:
+    explicit reader(const std::string &path)
+    {
+      _fd = ::open(path.c_str(), O_RDONLY);
+      if (_fd < 0)
+        throw std::runtime_error("cannot open " + path);
+      struct stat st;
+      if (fstat(_fd, &st) != 0 || size_t(st.st_size) < sizeof(file_header))
+      {
+        ::close(_fd);
+        throw std::runtime_error("not a snapshot: " + path);
+      }
+      _size = size_t(st.st_size);
+      auto base = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, _fd, 0);
+      if (base == MAP_FAILED)
+      {
+        ::close(_fd);
+        throw std::runtime_error("cannot map " + path);
+      }
+      _base = static_cast<const char *>(base);
+
+      try
+      {
+        index();
+      }
+      catch (const std::exception &e)
+      {
+        unmap();
+        throw std::runtime_error(std::string(e.what()) + ": " + path);
+      }
+    }
+
+    ~reader() { unmap(); }
+
+    reader(const reader &) = delete;
+    reader &operator=(const reader &) = delete;
+
+    const std::vector<table_view> &tables() const { return _tables; }
+
+    const table_view *find(const std::string &name) const
+    {
+      for (const auto &t : _tables)
+      {
+        if (t.name() == name)
+          return &t;
+      }
+      return nullptr;
+    }
+
+  private:
+    // every header and column has to lie inside the mapping, so a truncated
+    // or corrupt file is refused here rather than read past its end later
+    void index()
+    {
+      auto header = reinterpret_cast<const file_header *>(_base);
+      if (std::memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0)
+        throw std::runtime_error("not a snapshot");
+      uint64_t pos = sizeof(file_header);
+      for (uint32_t i = 0; i < header->table_count; i++)
+      {
+        require(pos, sizeof(table_header), "table header");
+        auto table = reinterpret_cast<const table_header *>(_base + pos);
+        pos += sizeof(table_header);
+        require(pos, uint64_t(table->column_count) * sizeof(column_header), "column headers");
+        auto columns = reinterpret_cast<const column_header *>(_base + pos);
+        for (uint32_t c = 0; c < table->column_count; c++)
+        {
+          const auto &column = columns[c];
+          if (column.width != 8 && column.width != 16)
+            throw std::runtime_error("invalid column width " + std::to_string(column.width));
+          if (column.offset % ALIGNMENT != 0)
+            throw std::runtime_error("misaligned column");
+          if (table->rows > _size / column.width)
+            throw std::runtime_error("column data past the end of the file");
+          require(column.offset, table->rows * column.width, "column data");
+        }
+        pos += uint64_t(table->column_count) * sizeof(column_header);
+        _tables.emplace_back(_base, table);
+      }
+    }
+
+    void require(uint64_t offset, uint64_t length, const char *what) const
+    {
+      if (offset > _size || length > _size - offset)
+        throw std::runtime_error(std::string(what) + " past the end of the file");
+    }
+
+    void unmap()
+    {
+      if (_base != nullptr)
+        munmap(const_cast<char *>(_base), _size);
+      if (_fd >= 0)
+        ::close(_fd);
+      _base = nullptr;
+      _fd = -1;
+    }
+
+    int _fd = -1;
+    size_t _size = 0;
+    const char *_base = nullptr;
+    std::vector<table_view> _tables;
+  };
+} // namespace snapshot
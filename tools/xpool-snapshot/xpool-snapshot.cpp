@@ -0,0 +1,610 @@
+#include "snapshot.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+// Converts a JSON lines dump of contract tables into a columnar snapshot
+// (see snapshot.hpp). Each input line is one row:
+//
+//   {"code":"eoscatspools","scope":1,"table":"minersv1","row":{"owner":"...",...}}
+//
+// which is the format written by xpool_tester::dump_tables. Rows of tables
+// without a schema below are skipped. logdeposit action payloads taken from
+// the chain history go in the same way, as rows of a "logdeposit" table with
+// the block time next to them:
+//
+//   {"code":"eoscatspools","time":1630426250,"table":"logdeposit","row":{"owner":"...","pool_id":1,"staked":"9.0000 EOS",...}}
+
+namespace
+{
+  typedef unsigned __int128 uint128_t;
+
+  enum class kind
+  {
+    u64,          // integer, also as a quoted string
+    u128,         // decimal or 0x hex, usually quoted
+    name,         // eosio account name
+    symbol,       // "4,EOS"
+    asset_amount, // amount of "9.0000 EOS"
+    asset_symbol, // symbol of "9.0000 EOS"
+  };
+
+  struct column_spec
+  {
+    const char *field; // path in the flattened input row
+    const char *column;
+    kind type;
+    bool extension = false; // binary_extension field, 0 in rows written before it existed
+  };
+
+  struct table_spec
+  {
+    const char *table;
+    std::vector<column_spec> columns;
+  };
+
+  const std::vector<table_spec> &schemas()
+  {
+    static const std::vector<table_spec> specs = {
+        {"pools",
+         {{"code", "code", kind::name},
+          {"row.id", "id", kind::u64},
+          {"row.type", "type", kind::u64},
+          {"row.contract", "contract", kind::name},
+          {"row.sym", "sym", kind::symbol},
+          {"row.total_staked", "total_staked", kind::asset_amount},
+          {"row.total_reward", "total_reward", kind::asset_amount},
+          {"row.released_reward", "released_reward", kind::asset_amount},
+          {"row.epoch_time", "epoch_time", kind::u64},
+          {"row.duration", "duration", kind::u64},
+          {"row.min_staked", "min_staked", kind::asset_amount},
+          {"row.last_harvest_time", "last_harvest_time", kind::u64},
+          {"row.acc_reward_per_share", "acc_reward_per_share", kind::u128, true},
+          {"row.reward_dust", "reward_dust", kind::u64, true}}},
+        {"poolstats",
+         {{"code", "code", kind::name},
+          {"row.id", "id", kind::u64},
+          {"row.total_staked", "total_staked", kind::u64},
+          {"row.released_reward", "released_reward", kind::u64},
+          {"row.last_harvest_time", "last_harvest_time", kind::u64},
+          {"row.acc_reward_per_share", "acc_reward_per_share", kind::u128},
+          {"row.reward_dust", "reward_dust", kind::u64},
+          {"row.distributed", "distributed", kind::u64}}},
+        {"minersv1",
+         {{"code", "code", kind::name},
+          {"scope", "pool_id", kind::u64},
+          {"row.owner", "owner", kind::name},
+          {"row.staked", "staked", kind::u64},
+          {"row.claimed", "claimed", kind::u64},
+          {"row.unclaimed", "unclaimed", kind::u64},
+          {"row.reward_debt", "reward_debt", kind::u128}}},
+        {"miners",
+         {{"code", "code", kind::name},
+          {"scope", "pool_id", kind::u64},
+          {"row.owner", "owner", kind::name},
+          {"row.staked", "staked", kind::asset_amount},
+          {"row.claimed", "claimed", kind::asset_amount},
+          {"row.unclaimed", "unclaimed", kind::asset_amount}}},
+        {"logdeposit",
+         {{"code", "code", kind::name},
+          {"time", "time", kind::u64},
+          {"row.owner", "owner", kind::name},
+          {"row.pool_id", "pool_id", kind::u64},
+          {"row.staked", "staked", kind::asset_amount}}},
+        {"fees",
+         {{"code", "code", kind::name},
+          {"scope", "contract", kind::u64},
+          {"row.balance", "balance", kind::asset_amount},
+          {"row.balance", "sym", kind::asset_symbol}}},
+        {"accounts",
+         {{"code", "code", kind::name},
+          {"scope", "owner", kind::u64},
+          {"row.balance", "balance", kind::asset_amount},
+          {"row.balance", "sym", kind::asset_symbol}}},
+    };
+    return specs;
+  }
+
+  uint32_t width(kind type)
+  {
+    return type == kind::u128 ? 16 : 8;
+  }
+
+  // ---- JSON ----------------------------------------------------------------
+
+  // Flattens one JSON object into path -> scalar text, nested objects joined
+  // with '.'. Only what the dump format needs: arrays are kept as raw text
+  // (no schema column reads them), basic escapes.
+  class json_line
+  {
+  public:
+    explicit json_line(const std::string &text) : _s(text) {}
+
+    std::map<std::string, std::string> parse()
+    {
+      std::map<std::string, std::string> fields;
+      skip_ws();
+      object("", fields);
+      skip_ws();
+      if (_pos != _s.size())
+        fail("trailing characters");
+      return fields;
+    }
+
+  private:
+    void object(const std::string &prefix, std::map<std::string, std::string> &fields)
+    {
+      expect('{');
+      skip_ws();
+      if (peek() == '}')
+      {
+        _pos++;
+        return;
+      }
+      while (true)
+      {
+        skip_ws();
+        auto key = prefix + string_value();
+        skip_ws();
+        expect(':');
+        skip_ws();
+        if (peek() == '{')
+          object(key + ".", fields);
+        else if (peek() == '"')
+          fields[key] = string_value();
+        else if (peek() == '[')
+          fields[key] = raw_array();
+        else
+          fields[key] = literal();
+        skip_ws();
+        if (peek() == ',')
+        {
+          _pos++;
+          continue;
+        }
+        expect('}');
+        return;
+      }
+    }
+
+    std::string string_value()
+    {
+      expect('"');
+      std::string out;
+      while (peek() != '"')
+      {
+        auto c = _s[_pos++];
+        if (c == '\\')
+        {
+          auto e = peek();
+          _pos++;
+          out += e == 'n' ? '\n' : e == 't' ? '\t' : e;
+        }
+        else
+        {
+          out += c;
+        }
+      }
+      _pos++;
+      return out;
+    }
+
+    std::string raw_array()
+    {
+      auto start = _pos;
+      int depth = 0;
+      do
+      {
+        auto c = peek();
+        if (c == '"')
+        {
+          string_value();
+          continue;
+        }
+        if (c == '[' || c == '{')
+          depth++;
+        else if (c == ']' || c == '}')
+          depth--;
+        _pos++;
+      } while (depth > 0);
+      return _s.substr(start, _pos - start);
+    }
+
+    std::string literal()
+    {
+      auto start = _pos;
+      while (_pos < _s.size() && _s[_pos] != ',' && _s[_pos] != '}' && !std::isspace(static_cast<unsigned char>(_s[_pos])))
+        _pos++;
+      if (start == _pos)
+        fail("expected a value");
+      return _s.substr(start, _pos - start);
+    }
+
+    char peek() const
+    {
+      if (_pos >= _s.size())
+        throw std::runtime_error("unexpected end of line");
+      return _s[_pos];
+    }
+
+    void expect(char c)
+    {
+      if (peek() != c)
+        fail(std::string("expected '") + c + "'");
+      _pos++;
+    }
+
+    void skip_ws()
+    {
+      while (_pos < _s.size() && std::isspace(static_cast<unsigned char>(_s[_pos])))
+        _pos++;
+    }
+
+    [[noreturn]] void fail(const std::string &what) const
+    {
+      throw std::runtime_error(what + " at column " + std::to_string(_pos + 1));
+    }
+
+    const std::string &_s;
+    size_t _pos = 0;
+  };
+
+  // ---- value conversion ----------------------------------------------------
+
+  uint64_t char_to_name_value(char c)
+  {
+    if (c == '.')
+      return 0;
+    if (c >= '1' && c <= '5')
+      return uint64_t(c - '1') + 1;
+    if (c >= 'a' && c <= 'z')
+      return uint64_t(c - 'a') + 6;
+    throw std::runtime_error(std::string("invalid character in name: ") + c);
+  }
+
+  uint64_t to_name(const std::string &s)
+  {
+    if (s.size() > 13)
+      throw std::runtime_error("name is longer than 13 characters: " + s);
+    uint64_t value = 0;
+    auto n = std::min<size_t>(s.size(), 12);
+    for (size_t i = 0; i < n; i++)
+    {
+      value <<= 5;
+      value |= char_to_name_value(s[i]);
+    }
+    value <<= 4 + 5 * (12 - n);
+    if (s.size() == 13)
+    {
+      auto v = char_to_name_value(s[12]);
+      if (v > 0x0F)
+        throw std::runtime_error("invalid 13th character in name: " + s);
+      value |= v;
+    }
+    return value;
+  }
+
+  uint128_t to_u128(const std::string &s)
+  {
+    if (s.empty())
+      throw std::runtime_error("empty number");
+    uint128_t value = 0;
+    if (s.size() > 2 && s[0] == '0' && (s[1] == 'x' || s[1] == 'X'))
+    {
+      for (size_t i = 2; i < s.size(); i++)
+      {
+        auto c = std::tolower(static_cast<unsigned char>(s[i]));
+        if (!std::isxdigit(c))
+          throw std::runtime_error("invalid hex number: " + s);
+        value = value * 16 + uint128_t(std::isdigit(c) ? c - '0' : c - 'a' + 10);
+      }
+      return value;
+    }
+    for (auto c : s)
+    {
+      if (!std::isdigit(static_cast<unsigned char>(c)))
+        throw std::runtime_error("invalid number: " + s);
+      value = value * 10 + uint128_t(c - '0');
+    }
+    return value;
+  }
+
+  uint64_t to_u64(const std::string &s)
+  {
+    auto value = to_u128(s);
+    if (value >> 64)
+      throw std::runtime_error("number does not fit in 64 bits: " + s);
+    return uint64_t(value);
+  }
+
+  // same bit layout as eosio::symbol: precision in the low byte, code above
+  uint64_t to_symbol(uint8_t precision, const std::string &code)
+  {
+    if (code.empty() || code.size() > 7)
+      throw std::runtime_error("invalid symbol code: " + code);
+    uint64_t value = 0;
+    for (size_t i = 0; i < code.size(); i++)
+    {
+      if (code[i] < 'A' || code[i] > 'Z')
+        throw std::runtime_error("invalid symbol code: " + code);
+      value |= uint64_t(code[i]) << (8 * i);
+    }
+    return (value << 8) | precision;
+  }
+
+  uint64_t parse_symbol(const std::string &s)
+  {
+    auto comma = s.find(',');
+    if (comma == std::string::npos)
+      throw std::runtime_error("invalid symbol: " + s);
+    return to_symbol(uint8_t(to_u64(s.substr(0, comma))), s.substr(comma + 1));
+  }
+
+  // "9.0000 EOS" -> amount 90000 and symbol 4,EOS
+  std::pair<int64_t, uint64_t> parse_asset(const std::string &s)
+  {
+    auto space = s.find(' ');
+    if (space == std::string::npos)
+      throw std::runtime_error("invalid asset: " + s);
+    auto number = s.substr(0, space);
+    bool negative = !number.empty() && number[0] == '-';
+    if (negative)
+      number.erase(0, 1);
+    auto dot = number.find('.');
+    uint8_t precision = 0;
+    if (dot != std::string::npos)
+    {
+      precision = uint8_t(number.size() - dot - 1);
+      number.erase(dot, 1);
+    }
+    auto amount = int64_t(to_u64(number));
+    return {negative ? -amount : amount, to_symbol(precision, s.substr(space + 1))};
+  }
+
+  // ---- columns -------------------------------------------------------------
+
+  struct table_buffer
+  {
+    const table_spec *spec;
+    uint64_t rows = 0;
+    std::vector<std::vector<char>> columns;
+  };
+
+  template <typename T>
+  void append(std::vector<char> &column, T value)
+  {
+    auto p = reinterpret_cast<const char *>(&value);
+    column.insert(column.end(), p, p + sizeof(T));
+  }
+
+  void append_row(table_buffer &buffer, const std::map<std::string, std::string> &fields)
+  {
+    const auto &columns = buffer.spec->columns;
+    // convert every value before touching the buffers so a bad row leaves no partial columns
+    std::vector<uint128_t> values;
+    for (const auto &c : columns)
+    {
+      auto itr = fields.find(c.field);
+      if (itr == fields.end() && c.extension)
+      {
+        values.push_back(0);
+        continue;
+      }
+      if (itr == fields.end())
+        throw std::runtime_error(std::string("missing field ") + c.field);
+      const auto &text = itr->second;
+      switch (c.type)
+      {
+      case kind::u64:
+        values.push_back(to_u64(text));
+        break;
+      case kind::u128:
+        values.push_back(to_u128(text));
+        break;
+      case kind::name:
+        values.push_back(to_name(text));
+        break;
+      case kind::symbol:
+        values.push_back(parse_symbol(text));
+        break;
+      case kind::asset_amount:
+        values.push_back(uint64_t(parse_asset(text).first));
+        break;
+      case kind::asset_symbol:
+        values.push_back(parse_asset(text).second);
+        break;
+      }
+    }
+    for (size_t i = 0; i < columns.size(); i++)
+    {
+      if (columns[i].type == kind::u128)
+        append(buffer.columns[i], values[i]);
+      else
+        append(buffer.columns[i], uint64_t(values[i]));
+    }
+    buffer.rows++;
+  }
+
+  uint64_t align(uint64_t pos)
+  {
+    return (pos + snapshot::ALIGNMENT - 1) / snapshot::ALIGNMENT * snapshot::ALIGNMENT;
+  }
+
+  void write_snapshot(const std::string &path, const std::vector<table_buffer> &tables)
+  {
+    std::vector<const table_buffer *> present;
+    for (const auto &t : tables)
+    {
+      if (t.rows > 0)
+        present.push_back(&t);
+    }
+
+    uint64_t pos = sizeof(snapshot::file_header);
+    for (auto t : present)
+      pos += sizeof(snapshot::table_header) + t->columns.size() * sizeof(snapshot::column_header);
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out)
+      throw std::runtime_error("cannot write " + path);
+
+    snapshot::file_header header{};
+    std::memcpy(header.magic, snapshot::MAGIC, sizeof(snapshot::MAGIC));
+    header.table_count = uint32_t(present.size());
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+    for (auto t : present)
+    {
+      snapshot::table_header th{};
+      std::strncpy(th.name, t->spec->table, sizeof(th.name));
+      th.rows = t->rows;
+      th.column_count = uint32_t(t->columns.size());
+      out.write(reinterpret_cast<const char *>(&th), sizeof(th));
+      for (size_t i = 0; i < t->columns.size(); i++)
+      {
+        pos = align(pos);
+        snapshot::column_header ch{};
+        std::strncpy(ch.name, t->spec->columns[i].column, sizeof(ch.name));
+        ch.width = width(t->spec->columns[i].type);
+        ch.offset = pos;
+        out.write(reinterpret_cast<const char *>(&ch), sizeof(ch));
+        pos += t->columns[i].size();
+      }
+    }
+
+    for (auto t : present)
+    {
+      for (const auto &column : t->columns)
+      {
+        auto padding = align(uint64_t(out.tellp())) - uint64_t(out.tellp());
+        static const char zeros[snapshot::ALIGNMENT] = {};
+        out.write(zeros, std::streamsize(padding));
+        out.write(column.data(), std::streamsize(column.size()));
+      }
+    }
+    if (!out)
+      throw std::runtime_error("write failed: " + path);
+  }
+
+  int convert(const std::string &input, const std::string &output)
+  {
+    std::ifstream in(input);
+    if (!in)
+    {
+      std::cerr << "cannot open " << input << std::endl;
+      return 1;
+    }
+
+    std::vector<table_buffer> tables;
+    for (const auto &spec : schemas())
+      tables.push_back({&spec, 0, std::vector<std::vector<char>>(spec.columns.size())});
+
+    std::string line;
+    uint64_t line_no = 0, skipped = 0;
+    try
+    {
+      while (std::getline(in, line))
+      {
+        line_no++;
+        if (line.find_first_not_of(" \t\r") == std::string::npos)
+          continue;
+        const auto fields = json_line(line).parse();
+        auto table = fields.find("table");
+        if (table == fields.end())
+          throw std::runtime_error("missing field table");
+        auto buffer = std::find_if(tables.begin(), tables.end(), [&](const auto &t) { return table->second == t.spec->table; });
+        if (buffer == tables.end())
+        {
+          skipped++;
+          continue;
+        }
+        append_row(*buffer, fields);
+      }
+      write_snapshot(output, tables);
+    }
+    catch (const std::exception &e)
+    {
+      std::cerr << input << ":" << line_no << ": " << e.what() << std::endl;
+      return 1;
+    }
+
+    for (const auto &t : tables)
+    {
+      if (t.rows > 0)
+        std::cout << t.spec->table << ": " << t.rows << " rows" << std::endl;
+    }
+    if (skipped > 0)
+      std::cout << "skipped: " << skipped << " rows without a schema" << std::endl;
+    return 0;
+  }
+
+  int dump(const std::string &path)
+  {
+    try
+    {
+      snapshot::reader snap(path);
+      for (const auto &t : snap.tables())
+      {
+        std::cout << t.name() << ": " << t.rows() << " rows" << std::endl;
+        for (uint32_t i = 0; i < t.column_count(); i++)
+        {
+          const auto &c = t.column_at(i);
+          std::cout << "  " << std::string(c.name, strnlen(c.name, sizeof(c.name))) << " (" << c.width << " bytes)" << std::endl;
+        }
+      }
+    }
+    catch (const std::exception &e)
+    {
+      std::cerr << e.what() << std::endl;
+      return 1;
+    }
+    return 0;
+  }
+
+  // total of a 64-bit column, e.g. staked amounts when reconciling a pool
+  int sum(const std::string &path, const std::string &table, const std::string &column)
+  {
+    try
+    {
+      snapshot::reader snap(path);
+      auto t = snap.find(table);
+      if (t == nullptr)
+        throw std::runtime_error("no table " + table);
+      auto values = t->column<int64_t>(column);
+      int64_t total = 0;
+      for (uint64_t i = 0; i < t->rows(); i++)
+        total += values[i];
+      std::cout << table << "." << column << " = " << total << std::endl;
+    }
+    catch (const std::exception &e)
+    {
+      std::cerr << e.what() << std::endl;
+      return 1;
+    }
+    return 0;
+  }
+
+  void usage(const char *prog)
+  {
+    std::cerr << "Usage: " << prog << " <dump.jsonl> <snapshot.bin>\n"
+              << "       " << prog << " --dump <snapshot.bin>\n"
+              << "       " << prog << " --sum <snapshot.bin> <table> <column>" << std::endl;
+    std::exit(1);
+  }
+} // namespace
+
+int main(int argc, char *argv[])
+{
+  if (argc == 3 && std::strcmp(argv[1], "--dump") == 0)
+    return dump(argv[2]);
+  if (argc == 5 && std::strcmp(argv[1], "--sum") == 0)
+    return sum(argv[2], argv[3], argv[4]);
+  if (argc == 3 && argv[1][0] != '-')
+    return convert(argv[1], argv[2]);
+  usage(argv[0]);
+}